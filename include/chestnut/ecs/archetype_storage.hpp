@@ -0,0 +1,163 @@
+#pragma once
+
+#include "types.hpp"
+#include "entity_signature.hpp"
+#include "paged_sparse_array.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace chestnut::ecs::internal
+{
+    /**
+     * @brief Type-erased column of components of one type inside an archetype
+     */
+    class IArchetypeColumn
+    {
+    public:
+        virtual ~IArchetypeColumn() = default;
+
+        // creates an empty column of the same component type
+        virtual std::unique_ptr<IArchetypeColumn> makeEmpty() const = 0;
+        // moves the element at row to the back of the other column of the same component type
+        virtual void moveRowTo(unsigned int row, IArchetypeColumn& other) = 0;
+        // moves the last element into row and pops the back
+        virtual void swapRemove(unsigned int row) = 0;
+        virtual void reserve(unsigned int capacity) = 0;
+    };
+
+    template<typename T>
+    class CArchetypeColumn : public IArchetypeColumn
+    {
+    public:
+        std::vector<T> m_data;
+
+    public:
+        std::unique_ptr<IArchetypeColumn> makeEmpty() const override;
+        void moveRowTo(unsigned int row, IArchetypeColumn& other) override;
+        void swapRemove(unsigned int row) override;
+        void reserve(unsigned int capacity) override;
+    };
+
+
+    /**
+     * @brief Table of all entities with the exact same signature
+     *
+     * @details
+     * Components are stored column-major: each component type has its own contiguous array
+     * and entity at row N owns N-th element of every column.
+     */
+    class CArchetype
+    {
+    public:
+        inline static const int NIL_COLUMN = -1;
+        inline static const unsigned int NIL_EDGE = (unsigned int)-1;
+
+        CEntitySignature m_signature;
+        // sorted ascending, parallel to m_vecColumns
+        std::vector<componenttypeid_t> m_vecTypeIds;
+        std::vector<std::unique_ptr<IArchetypeColumn>> m_vecColumns;
+        // column index for each component type ID or NIL_COLUMN
+        std::vector<int> m_vecTypeToColumn;
+        // owners of rows
+        std::vector<entityid_t> m_vecEntityIDs;
+
+        // cached indices of archetypes that differ from this one by a single type, indexed by type ID
+        std::vector<unsigned int> m_vecAddEdges;
+        std::vector<unsigned int> m_vecRemoveEdges;
+
+    public:
+        int columnIndex(componenttypeid_t typeId) const noexcept;
+
+        template<typename T>
+        CArchetypeColumn<T> *column() noexcept;
+
+        template<typename T>
+        const CArchetypeColumn<T> *column() const noexcept;
+
+        unsigned int size() const noexcept;
+    };
+
+
+    /**
+     * @brief Component storage backend that groups entities into archetypes (tables per signature)
+     *
+     * @details
+     * Lookups are fast and queries can walk matching tables linearly, but every structural change
+     * of an entity moves all of its components to another table. Prefer sparse set storage
+     * for workloads that add and remove components very often.
+     */
+    class CArchetypeStorage
+    {
+    private:
+        // archetypes are never destroyed, so indices into this vector stay valid
+        std::vector<std::unique_ptr<CArchetype>> m_vecArchetypes;
+
+        // location of entity's components, NIL_INDEX if entity doesn't have any
+        CPagedSparseArray m_entityArchetypes;
+        CPagedSparseArray m_entityRows;
+
+
+    public:
+        CArchetypeStorage() = default;
+
+        template<typename T>
+        T& at(entityid_t id);
+
+        template<typename T>
+        const T& at(entityid_t id) const;
+
+        template<typename T>
+        bool contains(entityid_t id) const noexcept;
+
+        template<typename T>
+        entitysize_t size() const noexcept;
+
+
+        template<typename T>
+        void clear() noexcept;
+
+        template<typename T>
+        void insert(entityid_t id, T&& arg) noexcept;
+
+        template<typename T>
+        void erase(entityid_t id) noexcept;
+
+        void eraseAll(entityid_t id) noexcept;
+
+
+        const CArchetype *archetypeOf(entityid_t id) const noexcept;
+        unsigned int rowOf(entityid_t id) const noexcept;
+
+        // archetype index in high bits and row in low bits, entities sorted by it lie in memory order
+        uint64_t locationKey(entityid_t id) const noexcept;
+
+        /**
+         * @brief Calls the function for every archetype that has all types from require and none from reject signature
+         *
+         * @details Archetypes are visited in creation order
+         */
+        template<typename F>
+        void forEachMatchingArchetype(const CEntitySignature& require, const CEntitySignature& reject, F&& func);
+
+        unsigned int archetypeCount() const noexcept;
+
+    private:
+        template<typename T>
+        unsigned int findOrCreateWithAdded(int srcArchetype) noexcept;
+
+        unsigned int findOrCreateWithRemoved(unsigned int srcArchetype, componenttypeid_t typeId) noexcept;
+
+        unsigned int findArchetype(const CEntitySignature& signature) const noexcept;
+        unsigned int addArchetype(std::unique_ptr<CArchetype> archetype) noexcept;
+
+        // moves entity's row from its current archetype to dst, except for the component type skipped
+        void moveEntity(entityid_t id, unsigned int dstArchetype, componenttypeid_t skippedTypeId) noexcept;
+        void removeRow(unsigned int archetype, unsigned int row) noexcept;
+    };
+
+} // namespace chestnut::ecs::internal
+
+
+#include "archetype_storage.inl"
@@ -0,0 +1,440 @@
+#include "component_type_family.hpp"
+#include "exceptions.hpp"
+
+#include <algorithm> // sort
+#include <utility> // pair
+
+namespace chestnut::ecs::internal
+{
+
+template<typename T>
+std::unique_ptr<IArchetypeColumn> CArchetypeColumn<T>::makeEmpty() const
+{
+    return std::make_unique<CArchetypeColumn<T>>();
+}
+
+template<typename T>
+void CArchetypeColumn<T>::moveRowTo(unsigned int row, IArchetypeColumn& other)
+{
+    static_cast<CArchetypeColumn<T>&>(other).m_data.push_back(std::move(m_data[row]));
+}
+
+template<typename T>
+void CArchetypeColumn<T>::swapRemove(unsigned int row)
+{
+    if(row + 1 != m_data.size())
+    {
+        m_data[row] = std::move(m_data.back());
+    }
+
+    m_data.pop_back();
+}
+
+template<typename T>
+void CArchetypeColumn<T>::reserve(unsigned int capacity)
+{
+    m_data.reserve(capacity);
+}
+
+
+
+
+inline int CArchetype::columnIndex(componenttypeid_t typeId) const noexcept
+{
+    if(typeId >= m_vecTypeToColumn.size())
+    {
+        return NIL_COLUMN;
+    }
+
+    return m_vecTypeToColumn[typeId];
+}
+
+template<typename T>
+inline CArchetypeColumn<T> *CArchetype::column() noexcept
+{
+    const int col = columnIndex(CComponentTypeFamily::id<T>());
+    if(col == NIL_COLUMN)
+    {
+        return nullptr;
+    }
+
+    return static_cast<CArchetypeColumn<T> *>(m_vecColumns[col].get());
+}
+
+template<typename T>
+inline const CArchetypeColumn<T> *CArchetype::column() const noexcept
+{
+    const int col = columnIndex(CComponentTypeFamily::id<T>());
+    if(col == NIL_COLUMN)
+    {
+        return nullptr;
+    }
+
+    return static_cast<const CArchetypeColumn<T> *>(m_vecColumns[col].get());
+}
+
+inline unsigned int CArchetype::size() const noexcept
+{
+    return (unsigned int)m_vecEntityIDs.size();
+}
+
+
+
+
+template<typename T>
+inline T& CArchetypeStorage::at(entityid_t id)
+{
+    const int arch = m_entityArchetypes[id];
+    if(arch == CPagedSparseArray::NIL_INDEX)
+    {
+        throw BadStorageAccessException();
+    }
+
+    CArchetypeColumn<T> *col = m_vecArchetypes[arch]->template column<T>();
+    if(!col)
+    {
+        throw BadStorageAccessException();
+    }
+
+    return col->m_data[m_entityRows[id]];
+}
+
+template<typename T>
+inline const T& CArchetypeStorage::at(entityid_t id) const
+{
+    const int arch = m_entityArchetypes[id];
+    if(arch == CPagedSparseArray::NIL_INDEX)
+    {
+        throw BadStorageAccessException();
+    }
+
+    const CArchetypeColumn<T> *col = m_vecArchetypes[arch]->template column<T>();
+    if(!col)
+    {
+        throw BadStorageAccessException();
+    }
+
+    return col->m_data[m_entityRows[id]];
+}
+
+template<typename T>
+inline bool CArchetypeStorage::contains(entityid_t id) const noexcept
+{
+    const int arch = m_entityArchetypes[id];
+    if(arch == CPagedSparseArray::NIL_INDEX)
+    {
+        return false;
+    }
+
+    return m_vecArchetypes[arch]->columnIndex(CComponentTypeFamily::id<T>()) != CArchetype::NIL_COLUMN;
+}
+
+template<typename T>
+inline entitysize_t CArchetypeStorage::size() const noexcept
+{
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
+
+    entitysize_t size = 0;
+    for(const auto& arch : m_vecArchetypes)
+    {
+        if(arch->m_signature.has(typeId))
+        {
+            size += arch->size();
+        }
+    }
+
+    return size;
+}
+
+template<typename T>
+inline void CArchetypeStorage::clear() noexcept
+{
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
+
+    std::vector<entityid_t> owners;
+    for(const auto& arch : m_vecArchetypes)
+    {
+        if(arch->m_signature.has(typeId))
+        {
+            owners.insert(owners.end(), arch->m_vecEntityIDs.begin(), arch->m_vecEntityIDs.end());
+        }
+    }
+
+    for(entityid_t id : owners)
+    {
+        erase<T>(id);
+    }
+}
+
+template<typename T>
+inline void CArchetypeStorage::insert(entityid_t id, T&& arg) noexcept
+{
+    const int src = m_entityArchetypes[id];
+
+    if(src != CPagedSparseArray::NIL_INDEX)
+    {
+        CArchetypeColumn<T> *col = m_vecArchetypes[src]->template column<T>();
+        if(col)
+        {
+            col->m_data[m_entityRows[id]] = std::forward<T>(arg);
+            return;
+        }
+    }
+
+    const unsigned int dst = findOrCreateWithAdded<T>(src);
+
+    moveEntity(id, dst, COMPONENT_TYPE_ID_INVALID);
+    m_vecArchetypes[dst]->template column<T>()->m_data.push_back(std::forward<T>(arg));
+}
+
+template<typename T>
+inline void CArchetypeStorage::erase(entityid_t id) noexcept
+{
+    if(!contains<T>(id))
+    {
+        return;
+    }
+
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
+    const unsigned int src = (unsigned int)m_entityArchetypes[id];
+    const unsigned int dst = findOrCreateWithRemoved(src, typeId);
+
+    if(dst == CArchetype::NIL_EDGE)
+    {
+        eraseAll(id);
+    }
+    else
+    {
+        moveEntity(id, dst, typeId);
+    }
+}
+
+inline void CArchetypeStorage::eraseAll(entityid_t id) noexcept
+{
+    const int arch = m_entityArchetypes[id];
+    if(arch != CPagedSparseArray::NIL_INDEX)
+    {
+        removeRow((unsigned int)arch, (unsigned int)m_entityRows[id]);
+        m_entityArchetypes.set(id, CPagedSparseArray::NIL_INDEX);
+        m_entityRows.set(id, CPagedSparseArray::NIL_INDEX);
+    }
+}
+
+inline const CArchetype *CArchetypeStorage::archetypeOf(entityid_t id) const noexcept
+{
+    const int arch = m_entityArchetypes[id];
+    if(arch == CPagedSparseArray::NIL_INDEX)
+    {
+        return nullptr;
+    }
+
+    return m_vecArchetypes[arch].get();
+}
+
+inline unsigned int CArchetypeStorage::rowOf(entityid_t id) const noexcept
+{
+    return (unsigned int)m_entityRows[id];
+}
+
+inline uint64_t CArchetypeStorage::locationKey(entityid_t id) const noexcept
+{
+    return ((uint64_t)(uint32_t)m_entityArchetypes[id] << 32) | (uint32_t)m_entityRows[id];
+}
+
+template<typename F>
+inline void CArchetypeStorage::forEachMatchingArchetype(const CEntitySignature& require, const CEntitySignature& reject, F&& func)
+{
+    for(const auto& arch : m_vecArchetypes)
+    {
+        if(arch->m_signature.hasAllFrom(require) && !arch->m_signature.hasAnyFrom(reject))
+        {
+            func(*arch);
+        }
+    }
+}
+
+inline unsigned int CArchetypeStorage::archetypeCount() const noexcept
+{
+    return (unsigned int)m_vecArchetypes.size();
+}
+
+
+
+
+template<typename T>
+inline unsigned int CArchetypeStorage::findOrCreateWithAdded(int srcArchetype) noexcept
+{
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
+
+    CArchetype *src = nullptr;
+    if(srcArchetype != CPagedSparseArray::NIL_INDEX)
+    {
+        src = m_vecArchetypes[srcArchetype].get();
+
+        if(typeId < src->m_vecAddEdges.size() && src->m_vecAddEdges[typeId] != CArchetype::NIL_EDGE)
+        {
+            return src->m_vecAddEdges[typeId];
+        }
+    }
+
+    CEntitySignature signature = src ? src->m_signature : CEntitySignature();
+    signature.add(typeId);
+
+    unsigned int dst = findArchetype(signature);
+    if(dst == CArchetype::NIL_EDGE)
+    {
+        std::vector<std::pair<componenttypeid_t, std::unique_ptr<IArchetypeColumn>>> columns;
+        if(src)
+        {
+            for(size_t i = 0; i < src->m_vecColumns.size(); i++)
+            {
+                columns.emplace_back(src->m_vecTypeIds[i], src->m_vecColumns[i]->makeEmpty());
+            }
+        }
+        columns.emplace_back(typeId, std::make_unique<CArchetypeColumn<T>>());
+
+        auto arch = std::make_unique<CArchetype>();
+        arch->m_signature = signature;
+        std::sort(columns.begin(), columns.end(), [](const auto& c1, const auto& c2) {
+            return c1.first < c2.first;
+        });
+        for(auto& [colTypeId, col] : columns)
+        {
+            arch->m_vecTypeIds.push_back(colTypeId);
+            arch->m_vecColumns.push_back(std::move(col));
+        }
+
+        dst = addArchetype(std::move(arch));
+    }
+
+    if(src)
+    {
+        if(typeId >= src->m_vecAddEdges.size())
+        {
+            src->m_vecAddEdges.resize(typeId + 1, CArchetype::NIL_EDGE);
+        }
+        src->m_vecAddEdges[typeId] = dst;
+    }
+
+    return dst;
+}
+
+inline unsigned int CArchetypeStorage::findOrCreateWithRemoved(unsigned int srcArchetype, componenttypeid_t typeId) noexcept
+{
+    CArchetype *src = m_vecArchetypes[srcArchetype].get();
+
+    if(typeId < src->m_vecRemoveEdges.size() && src->m_vecRemoveEdges[typeId] != CArchetype::NIL_EDGE)
+    {
+        return src->m_vecRemoveEdges[typeId];
+    }
+
+    CEntitySignature signature = src->m_signature;
+    signature.remove(typeId);
+
+    if(signature.isEmpty())
+    {
+        return CArchetype::NIL_EDGE;
+    }
+
+    unsigned int dst = findArchetype(signature);
+    if(dst == CArchetype::NIL_EDGE)
+    {
+        auto arch = std::make_unique<CArchetype>();
+        arch->m_signature = signature;
+        for(size_t i = 0; i < src->m_vecColumns.size(); i++)
+        {
+            if(src->m_vecTypeIds[i] != typeId)
+            {
+                arch->m_vecTypeIds.push_back(src->m_vecTypeIds[i]);
+                arch->m_vecColumns.push_back(src->m_vecColumns[i]->makeEmpty());
+            }
+        }
+
+        dst = addArchetype(std::move(arch));
+    }
+
+    if(typeId >= src->m_vecRemoveEdges.size())
+    {
+        src->m_vecRemoveEdges.resize(typeId + 1, CArchetype::NIL_EDGE);
+    }
+    src->m_vecRemoveEdges[typeId] = dst;
+
+    return dst;
+}
+
+inline unsigned int CArchetypeStorage::findArchetype(const CEntitySignature& signature) const noexcept
+{
+    // only called when an edge is missing, so the linear search is fine
+    for(unsigned int i = 0; i < (unsigned int)m_vecArchetypes.size(); i++)
+    {
+        if(m_vecArchetypes[i]->m_signature == signature)
+        {
+            return i;
+        }
+    }
+
+    return CArchetype::NIL_EDGE;
+}
+
+inline unsigned int CArchetypeStorage::addArchetype(std::unique_ptr<CArchetype> archetype) noexcept
+{
+    if(!archetype->m_vecTypeIds.empty())
+    {
+        archetype->m_vecTypeToColumn.resize(archetype->m_vecTypeIds.back() + 1, CArchetype::NIL_COLUMN);
+    }
+    for(int col = 0; col < (int)archetype->m_vecTypeIds.size(); col++)
+    {
+        archetype->m_vecTypeToColumn[archetype->m_vecTypeIds[col]] = col;
+    }
+
+    m_vecArchetypes.push_back(std::move(archetype));
+    return (unsigned int)m_vecArchetypes.size() - 1;
+}
+
+inline void CArchetypeStorage::moveEntity(entityid_t id, unsigned int dstArchetype, componenttypeid_t skippedTypeId) noexcept
+{
+    CArchetype& dst = *m_vecArchetypes[dstArchetype];
+
+    const int srcArchetype = m_entityArchetypes[id];
+    if(srcArchetype != CPagedSparseArray::NIL_INDEX)
+    {
+        CArchetype& src = *m_vecArchetypes[srcArchetype];
+        const unsigned int srcRow = (unsigned int)m_entityRows[id];
+
+        for(size_t i = 0; i < src.m_vecColumns.size(); i++)
+        {
+            if(src.m_vecTypeIds[i] != skippedTypeId)
+            {
+                src.m_vecColumns[i]->moveRowTo(srcRow, *dst.m_vecColumns[dst.columnIndex(src.m_vecTypeIds[i])]);
+            }
+        }
+
+        removeRow((unsigned int)srcArchetype, srcRow);
+    }
+
+    dst.m_vecEntityIDs.push_back(id);
+    m_entityArchetypes.set(id, (int)dstArchetype);
+    m_entityRows.set(id, (int)dst.m_vecEntityIDs.size() - 1);
+}
+
+inline void CArchetypeStorage::removeRow(unsigned int archetype, unsigned int row) noexcept
+{
+    CArchetype& arch = *m_vecArchetypes[archetype];
+
+    for(auto& col : arch.m_vecColumns)
+    {
+        col->swapRemove(row);
+    }
+
+    const unsigned int lastRow = (unsigned int)arch.m_vecEntityIDs.size() - 1;
+    if(row != lastRow)
+    {
+        const entityid_t movedId = arch.m_vecEntityIDs[lastRow];
+        arch.m_vecEntityIDs[row] = movedId;
+        m_entityRows.set(movedId, (int)row);
+    }
+
+    arch.m_vecEntityIDs.pop_back();
+}
+
+} // namespace chestnut::ecs::internal
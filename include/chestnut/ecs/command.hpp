@@ -1,7 +1,5 @@
 #pragma once
 
-#include <cstddef>
-
 namespace chestnut::ecs
 {
     class CEntityWorld;
@@ -12,7 +10,6 @@ namespace chestnut::ecs
         virtual ~ICommand() = default;
 
         virtual void excecute(CEntityWorld& world) = 0;
-        virtual size_t size() const = 0;
     };
 
 } // namespace chestnut::ecs
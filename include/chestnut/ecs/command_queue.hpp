@@ -1,58 +1,380 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <vector>
 
 #include "command.hpp"
+#include "entity_world.hpp"
 
 namespace chestnut::ecs
 {
-    class CEntityWorld;
-
+    /**
+     * @brief Queue of commands stored in a chain of memory blocks
+     *
+     * @details
+     * Commands are constructed directly in fixed-size blocks and never move until they're executed.
+     * Each one is placed at an address aligned for its type, over-aligned types included.
+     * Blocks aren't freed after executing or clearing the queue, but reused for next commands,
+     * so after the first few frames recording commands doesn't allocate at all.
+     * Each command is preceded by a small header that says where the next one starts.
+     *
+     * Commands can carry a sort key, which decides their order when many queues are executed together with executeMerged().
+     *
+     * Commands are executed through a table of functions made for their exact type, so no virtual calls are made.
+     * Consecutive commands of the same type are handed over together to command's static executeBatch(),
+     * if it has one with signature `static void executeBatch(C *const *cmds, size_t count, CEntityWorld& world)`.
+     * It's expected to have the same effect as executing the commands one by one.
+     * All commands are executed inside a world batch, so queries get updated once at the end.
+     * Entities reserved with CEntityWorld::reserveEntity() are created before any command is executed.
+     */
     class CCommandQueue
     {
+    public:
+        inline static const size_t BLOCK_SIZE = 16 * 1024;
+        // alignment of block memory, commands aligned to at most this much never need padding before them
+        inline static const size_t BLOCK_ALIGNMENT = 64;
+
     private:
-        std::vector<std::byte> m_buff;
+        struct SCommandOps
+        {
+            void (*executeBatch)(void *const *cmds, size_t count, CEntityWorld& world);
+            void (*destroy)(void *cmd) noexcept;
+        };
+
+        struct SCommandHeader
+        {
+            // null after the command has been destroyed
+            void *cmd;
+            // the same table for all commands of the same type
+            const SCommandOps *ops;
+            // offset of the next header in the block
+            size_t nextOffset;
+            uint64_t sortKey;
+        };
+
+        struct SBlockDeleter
+        {
+            void operator()(std::byte *data) const noexcept
+            {
+                ::operator delete(data, std::align_val_t(BLOCK_ALIGNMENT));
+            }
+        };
+
+        struct SBlock
+        {
+            std::unique_ptr<std::byte, SBlockDeleter> data;
+            size_t capacity;
+            size_t used;
+        };
+
+        std::vector<SBlock> m_vecBlocks;
+        // index of the block commands currently get written to, blocks after it are free
+        size_t m_currentBlockIdx;
+        // headers of commands being executed, kept to avoid allocations
+        std::vector<SCommandHeader *> m_vecHeadersToExecute;
 
     public:
-        template<typename C, std::enable_if_t<std::is_base_of_v<ICommand, C>, bool> = true>
-        void insert(C &&cmd)
+        CCommandQueue() noexcept
+        : m_currentBlockIdx(0)
         {
-            size_t cmdSize = cmd.size();
 
-            // make room for the new command
-            m_buff.resize(m_buff.size() + cmdSize);
+        }
 
-            // pointer to the beginning of the buffer space for the new command
-            std::byte *eob = m_buff.data() + m_buff.size() - cmdSize;
+        CCommandQueue(const CCommandQueue&) = delete;
+        CCommandQueue& operator=(const CCommandQueue&) = delete;
 
-            // use placement new to safely move the command and its contents to the buffer
-            new (eob) C(std::move(cmd));
+        CCommandQueue(CCommandQueue&& other) noexcept
+        : m_vecBlocks(std::move(other.m_vecBlocks)), m_currentBlockIdx(other.m_currentBlockIdx)
+        {
+            other.m_vecBlocks.clear();
+            other.m_currentBlockIdx = 0;
+        }
+
+        CCommandQueue& operator=(CCommandQueue&& other) noexcept
+        {
+            if(this != &other)
+            {
+                clear();
+                m_vecBlocks = std::move(other.m_vecBlocks);
+                m_currentBlockIdx = other.m_currentBlockIdx;
+                other.m_vecBlocks.clear();
+                other.m_currentBlockIdx = 0;
+            }
+            return *this;
+        }
+
+        // Destroys commands that haven't been executed
+        ~CCommandQueue()
+        {
+            clear();
+        }
+
+
+        template<typename C, std::enable_if_t<std::is_base_of_v<ICommand, std::decay_t<C>>, bool> = true>
+        void insert(C &&cmd, uint64_t sortKey = 0)
+        {
+            emplace<std::decay_t<C>>(sortKey, std::forward<C>(cmd));
         }
 
+        /**
+         * @brief Constructs command of type C directly in the queue's memory
+         * 
+         * @param sortKey sort key of the command
+         * @param args arguments for C's constructor
+         * @return reference to the constructed command, valid until the queue is executed or cleared
+         */
+        template<typename C, typename... Args>
+        C& emplace(uint64_t sortKey, Args&&... args)
+        {
+            static_assert(std::is_base_of_v<ICommand, C>, "C must be a command");
+
+            SBlock& block = blockWithSpaceFor(sizeof(C), alignof(C));
+            std::byte *record = block.data.get() + block.used;
+            std::byte *cmdAddress = commandAddress(record, alignof(C));
+            const size_t recordEnd = alignUp((size_t)(cmdAddress + sizeof(C) - block.data.get()), alignof(SCommandHeader));
+
+            // use placement new to construct the command in its final place
+            C *placed = new (cmdAddress) C(std::forward<Args>(args)...);
+            new (record) SCommandHeader{ placed, &s_commandOps<C>, recordEnd, sortKey };
+
+            block.used = recordEnd;
+
+            return *placed;
+        }
+
+        bool empty() const noexcept
+        {
+            for(size_t b = 0; b <= m_currentBlockIdx && b < m_vecBlocks.size(); b++)
+            {
+                if(m_vecBlocks[b].used > 0)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Destroys all commands without executing them
         void clear()
         {
-            m_buff.clear();
+            forEachHeader([](SCommandHeader *header) {
+                void *cmd = header->cmd;
+                header->cmd = nullptr;
+                header->ops->destroy(cmd);
+            });
+
+            freeBlocks();
+        }
+
+        // Executes commands in the order they were inserted and removes them from the queue
+        void execute(CEntityWorld& world)
+        {
+            m_vecHeadersToExecute.clear();
+            forEachHeader([this](SCommandHeader *header) {
+                m_vecHeadersToExecute.push_back(header);
+            });
+
+            executeHeaders(m_vecHeadersToExecute, world);
+
+            freeBlocks();
+        }
+
+        /**
+         * @brief Executes commands of all queues ordered by their sort keys and removes them from the queues
+         *
+         * @details
+         * Commands with equal keys are executed in the order of queues they're in and then in the order they were inserted.
+         *
+         * @param queues queues to execute
+         * @param queueCount number of queues
+         * @param world world to execute commands on
+         */
+        static void executeMerged(CCommandQueue *const *queues, size_t queueCount, CEntityWorld& world)
+        {
+            std::vector<SCommandHeader *> headers;
+            for(size_t q = 0; q < queueCount; q++)
+            {
+                queues[q]->forEachHeader([&headers](SCommandHeader *header) {
+                    headers.push_back(header);
+                });
+            }
+
+            auto keyLess = [](const SCommandHeader *h1, const SCommandHeader *h2) {
+                return h1->sortKey < h2->sortKey;
+            };
+
+            // commands recorded with no keys or in key order don't need sorting
+            if(!std::is_sorted(headers.begin(), headers.end(), keyLess))
+            {
+                std::stable_sort(headers.begin(), headers.end(), keyLess);
+            }
+
+            executeHeaders(headers, world);
+
+            for(size_t q = 0; q < queueCount; q++)
+            {
+                queues[q]->freeBlocks();
+            }
+        }
+
+
+    private:
+        // detects static C::executeBatch(C *const *, size_t, CEntityWorld&)
+        template<typename C, typename = void>
+        struct HasExecuteBatch : std::false_type {};
+
+        template<typename C>
+        struct HasExecuteBatch<C, std::void_t<decltype(C::executeBatch(std::declval<C *const *>(), size_t(), std::declval<CEntityWorld&>()))>> : std::true_type {};
+
+        template<typename C>
+        static void executeBatchOf(void *const *cmds, size_t count, CEntityWorld& world)
+        {
+            if constexpr(HasExecuteBatch<C>::value)
+            {
+                C::executeBatch(reinterpret_cast<C *const *>(cmds), count, world);
+            }
+            else
+            {
+                for(size_t i = 0; i < count; i++)
+                {
+                    // qualified call isn't dispatched through the vtable
+                    static_cast<C *>(cmds[i])->C::excecute(world);
+                }
+            }
         }
 
-        void execute(CEntityWorld& world) const
+        template<typename C>
+        static void destroyOf(void *cmd) noexcept
         {
-            if(m_buff.empty())
+            // destructor called explicitly because of previously used placement-new
+            static_cast<C *>(cmd)->C::~C();
+        }
+
+        template<typename C>
+        inline static const SCommandOps s_commandOps { &executeBatchOf<C>, &destroyOf<C> };
+
+
+        static size_t alignUp(size_t offset, size_t alignment) noexcept
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        // where a command with given alignment goes in the record starting at given address;
+        // the command follows the header, padded to the absolute address so that block alignment doesn't matter
+        static std::byte *commandAddress(std::byte *record, size_t cmdAlignment) noexcept
+        {
+            const uintptr_t afterHeader = reinterpret_cast<uintptr_t>(record + sizeof(SCommandHeader));
+            return record + (alignUp(afterHeader, cmdAlignment) - reinterpret_cast<uintptr_t>(record));
+        }
+
+        SBlock& blockWithSpaceFor(size_t cmdSize, size_t cmdAlignment)
+        {
+            // free blocks left from previous frames are tried in order
+            for(; m_currentBlockIdx < m_vecBlocks.size(); m_currentBlockIdx++)
+            {
+                SBlock& block = m_vecBlocks[m_currentBlockIdx];
+                std::byte *record = block.data.get() + block.used;
+                const size_t cmdEnd = (size_t)(commandAddress(record, cmdAlignment) + cmdSize - block.data.get());
+
+                if(cmdEnd <= block.capacity)
+                {
+                    return block;
+                }
+            }
+
+            // commands that don't fit into a regular block get one of their own, with room for padding
+            const size_t maxRecordSize = sizeof(SCommandHeader) + cmdAlignment + cmdSize;
+            const size_t capacity = maxRecordSize > BLOCK_SIZE ? alignUp(maxRecordSize, alignof(SCommandHeader)) : BLOCK_SIZE;
+
+            std::byte *data = static_cast<std::byte *>(::operator new(capacity, std::align_val_t(BLOCK_ALIGNMENT)));
+            m_vecBlocks.push_back(SBlock{ std::unique_ptr<std::byte, SBlockDeleter>(data), capacity, 0 });
+            m_currentBlockIdx = m_vecBlocks.size() - 1;
+
+            return m_vecBlocks.back();
+        }
+
+        // calls func on headers of commands that haven't been destroyed yet, in insertion order
+        template<typename F>
+        void forEachHeader(F&& func)
+        {
+            for(size_t b = 0; b <= m_currentBlockIdx && b < m_vecBlocks.size(); b++)
+            {
+                SBlock& block = m_vecBlocks[b];
+
+                for(size_t offset = 0; offset < block.used;)
+                {
+                    SCommandHeader *header = std::launder(reinterpret_cast<SCommandHeader *>(block.data.get() + offset));
+                    offset = header->nextOffset;
+
+                    if(header->cmd)
+                    {
+                        func(header);
+                    }
+                }
+            }
+        }
+
+        // makes all blocks free for new commands; all commands must have been destroyed already
+        void freeBlocks() noexcept
+        {
+            for(size_t b = 0; b <= m_currentBlockIdx && b < m_vecBlocks.size(); b++)
             {
-                return;
+                m_vecBlocks[b].used = 0;
             }
 
-            for(size_t i = 0; i < m_buff.size();)
+            m_currentBlockIdx = 0;
+        }
+
+        // executes commands in given order, passing runs of the same type together, then destroys them
+        static void executeHeaders(const std::vector<SCommandHeader *>& headers, CEntityWorld& world)
+        {
+            // commands may refer to reserved entities in any order
+            world.flushReservedEntities();
+
+            CEntityWorld::BatchScope batch(world);
+
+            std::vector<void *> run;
+
+            for(size_t begin = 0; begin < headers.size();)
             {
-                const std::byte *data = &m_buff[i];
-                ICommand *cmd = (ICommand *)data;
-                size_t cmdSize = cmd->size();
+                const SCommandOps *ops = headers[begin]->ops;
+
+                size_t end = begin + 1;
+                while(end < headers.size() && headers[end]->ops == ops)
+                {
+                    end++;
+                }
+
+                // marked first, so that commands aren't destroyed twice if execution throws
+                run.clear();
+                for(size_t i = begin; i < end; i++)
+                {
+                    run.push_back(headers[i]->cmd);
+                    headers[i]->cmd = nullptr;
+                }
+
+                struct SDestroyGuard
+                {
+                    const SCommandOps *ops;
+                    std::vector<void *>& run;
+                    ~SDestroyGuard()
+                    {
+                        for(void *cmd : run)
+                        {
+                            ops->destroy(cmd);
+                        }
+                    }
+                } guard{ ops, run };
 
-                cmd->excecute(world);
-                cmd->~ICommand(); // destructor called explicitly because of previously used placement-new
+                ops->executeBatch(run.data(), run.size(), world);
 
-                i += cmdSize;
+                begin = end;
             }
         }
     };
@@ -3,15 +3,57 @@
 #include "command.hpp"
 #include "entity_world.hpp"
 #include "command_queue.hpp"
+#include "thread_pool.hpp"
 
+#include <cstdint>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace chestnut::ecs
 {
     template<class ...Cs>
     class CCreateEntityCommand;
-    
+
+    namespace internal
+    {
+        // calls func(begin, end, canRecycleId) for every run of consecutive entity creation commands with the same ID recycling setting
+        template<class Cmd, typename F>
+        void forEachRecyclingRun(Cmd *const *cmds, size_t count, F&& func)
+        {
+            for(size_t begin = 0; begin < count;)
+            {
+                const bool canRecycleId = cmds[begin]->canRecycleId();
+
+                size_t end = begin + 1;
+                while(end < count && cmds[end]->canRecycleId() == canRecycleId)
+                {
+                    end++;
+                }
+
+                func(begin, end, canRecycleId);
+                begin = end;
+            }
+        }
+
+        // constructs C with a constructor taking args or, if there's none, with aggregate initialization
+        // returned object is constructed directly in the place of the variable or member initialized with it
+        template<class C, typename... Args>
+        C makeComponent(Args&&... args)
+        {
+            if constexpr(std::is_constructible_v<C, Args&&...>)
+            {
+                return C(std::forward<Args>(args)...);
+            }
+            else
+            {
+                return C{ std::forward<Args>(args)... };
+            }
+        }
+
+    } // namespace internal
+
     template<>
     class CCreateEntityCommand<> : public ICommand
     {
@@ -25,14 +67,24 @@ namespace chestnut::ecs
 
         }
 
+        bool canRecycleId() const
+        {
+            return m_canRecycleId;
+        }
+
         void excecute(CEntityWorld& world) override
         {
             world.createEntity(m_canRecycleId);
         }
 
-        size_t size() const override
+        static void executeBatch(CCreateEntityCommand<> *const *cmds, size_t count, CEntityWorld& world)
         {
-            return sizeof(CCreateEntityCommand<>);
+            std::vector<entityid_t> ents;
+
+            internal::forEachRecyclingRun(cmds, count, [&world, &ents](size_t begin, size_t end, bool canRecycleId) {
+                ents.clear();
+                world.createEntities((entitysize_t)(end - begin), ents, canRecycleId);
+            });
         }
     };
 
@@ -51,14 +103,32 @@ namespace chestnut::ecs
 
         }
 
+        // each component is constructed from its argument without any intermediate tuple
+        template<typename... Args>
+        CCreateEntityCommand(std::in_place_t, bool canRecycleId, Args&&... data)
+        : m_data(std::forward<Args>(data)...), m_canRecycleId(canRecycleId)
+        {
+
+        }
+
+        bool canRecycleId() const
+        {
+            return m_canRecycleId;
+        }
+
         void excecute(CEntityWorld& world) override
         {
             world.createEntityWithComponents(std::move(m_data), m_canRecycleId);
         }
 
-        size_t size() const override
+        static void executeBatch(CCreateEntityCommand<C, CRest...> *const *cmds, size_t count, CEntityWorld& world)
         {
-            return sizeof(CCreateEntityCommand<C, CRest...>);
+            internal::forEachRecyclingRun(cmds, count, [cmds, &world](size_t begin, size_t end, bool canRecycleId) {
+                world.createEntitiesWithComponents<C, CRest...>((entitysize_t)(end - begin), 
+                [cmds, begin](entitysize_t i) -> TupleType&& {
+                    return std::move(cmds[begin + i]->m_data);
+                }, canRecycleId);
+            });
         }
     };
 
@@ -96,9 +166,44 @@ namespace chestnut::ecs
             world.destroyEntity(m_entityId);
         }
 
-        size_t size() const override
+        static void executeBatch(CDestroyEntityCommand *const *cmds, size_t count, CEntityWorld& world)
+        {
+            std::vector<entityid_t> ents(count);
+            for(size_t i = 0; i < count; i++)
+            {
+                ents[i] = cmds[i]->m_entityId;
+            }
+
+            world.destroyEntities(ents);
+        }
+    };
+
+
+
+    template<class ...Cs>
+    class CCreateReservedEntityCommand : public IEntityCommand
+    {
+    private:
+        std::tuple<Cs...> m_data;
+
+    public:
+        template<typename... Args>
+        CCreateReservedEntityCommand(entityid_t id, std::in_place_t, Args&&... data)
+        : IEntityCommand(id), m_data(std::forward<Args>(data)...)
+        {
+
+        }
+
+        void excecute(CEntityWorld& world) override
         {
-            return sizeof(CDestroyEntityCommand);
+            // entity has already been created by the flush the queue does before executing any command,
+            // only components are left to add
+            if constexpr(sizeof...(Cs) > 0)
+            {
+                std::apply([this, &world](Cs&... data) {
+                    world.createComponents(m_entityId, std::move(data)...);
+                }, m_data);
+            }
         }
     };
 
@@ -112,7 +217,15 @@ namespace chestnut::ecs
 
     public:
         CCreateOrUpdateComponentCommand(entityid_t id, C &&data)
-        : IEntityCommand(id), m_data(data)
+        : IEntityCommand(id), m_data(std::move(data))
+        {
+
+        }
+
+        // component is constructed from args right inside the command
+        template<typename... Args>
+        CCreateOrUpdateComponentCommand(entityid_t id, std::in_place_t, Args&&... args)
+        : IEntityCommand(id), m_data(internal::makeComponent<C>(std::forward<Args>(args)...))
         {
 
         }
@@ -122,9 +235,37 @@ namespace chestnut::ecs
             world.createOrUpdateComponent(m_entityId, std::move(m_data));
         }
 
-        size_t size() const override
+        static void executeBatch(CCreateOrUpdateComponentCommand<C> *const *cmds, size_t count, CEntityWorld& world)
         {
-            return sizeof(CCreateOrUpdateComponentCommand);
+            // components for entities that don't have them yet are created together at the end, 
+            // straight from the last command for the entity, so that data of earlier ones doesn't get moved at all;
+            // index into these vectors for each such entity lets later commands for it replace the pending component
+            std::vector<entityid_t> newEnts;
+            std::vector<C *> newComponents;
+            internal::CPagedSparseArray newEntSlots;
+
+            for(size_t i = 0; i < count; i++)
+            {
+                const entityid_t ent = cmds[i]->m_entityId;
+                const int slot = newEntSlots[ent];
+
+                if(slot != internal::CPagedSparseArray::NIL_INDEX)
+                {
+                    newComponents[slot] = &cmds[i]->m_data;
+                }
+                else if(world.hasComponent<C>(ent))
+                {
+                    world.createOrUpdateComponent(ent, std::move(cmds[i]->m_data));
+                }
+                else if(world.hasEntity(ent))
+                {
+                    newEntSlots.set(ent, (int)newEnts.size());
+                    newEnts.push_back(ent);
+                    newComponents.push_back(&cmds[i]->m_data);
+                }
+            }
+
+            world.createComponents(newEnts, newComponents.data());
         }
     };
 
@@ -150,11 +291,6 @@ namespace chestnut::ecs
                 m_updater(*handle);
             }
         }
-
-        size_t size() const override
-        {
-            return sizeof(CUpdateComponentCommand<C, F>);
-        }
     };
 
     template<class C>
@@ -171,11 +307,6 @@ namespace chestnut::ecs
         {
             world.destroyComponent<C>(m_entityId);
         }
-
-        size_t size() const override
-        {
-            return sizeof(CDestroyComponentCommand);
-        }
     };
 
 
@@ -184,62 +315,105 @@ namespace chestnut::ecs
     {
     private:
         CCommandQueue m_queue;
+        uint64_t m_sortKey = 0;
 
     public:
+        // Sort key for commands recorded from now on, 0 until set; see CParallelCommands
+        CCommands& sortKey(uint64_t key)
+        {
+            m_sortKey = key;
+            return *this;
+        }
+
+
         template<typename... Cs>
         CCommands& createEntity(Cs&&... data)
         {
-            using TupleType = std::tuple<Cs...>;
-            TupleType t = std::make_tuple(data...);
-            m_queue.insert(CCreateEntityCommand<Cs...>(std::forward<TupleType>(t), true));
+            m_queue.emplace<CCreateEntityCommand<std::decay_t<Cs>...>>(m_sortKey, std::in_place, true, std::forward<Cs>(data)...);
             return *this;
         }
 
         CCommands& createEntity()
         {
-            m_queue.insert(CCreateEntityCommand<>(true));
+            m_queue.insert(CCreateEntityCommand<>(true), m_sortKey);
             return *this;
         }
 
         template<typename... Cs>
         CCommands& createUniqueEntity(Cs&&... data)
         {
-            using TupleType = std::tuple<Cs...>;
-            TupleType t = std::make_tuple(data...);
-            m_queue.insert(CCreateEntityCommand<Cs...>(std::forward<TupleType>(t), false));
+            m_queue.emplace<CCreateEntityCommand<std::decay_t<Cs>...>>(m_sortKey, std::in_place, false, std::forward<Cs>(data)...);
             return *this;
         }
 
         CCommands& createUniqueEntity()
         {
-            m_queue.insert(CCreateEntityCommand<>(false));
+            m_queue.insert(CCreateEntityCommand<>(false), m_sortKey);
             return *this;
         }
 
+        /**
+         * @brief Reserve ID of an entity that gets created with given components when commands are executed
+         * 
+         * @details
+         * The ID can be used right away in next commands. 
+         * Reserving is lock-free, so it can be used from many threads at once, e.g. with CParallelCommands.
+         * If commands get cleared instead, the entity is still created, but without components.
+         * 
+         * @param world world the entity will be created in
+         * @param data components of the entity
+         * @return ID of the entity
+         */
+        template<typename... Cs>
+        entityid_t reserveEntity(CEntityWorld& world, Cs&&... data)
+        {
+            const entityid_t ent = world.reserveEntity();
+            m_queue.emplace<CCreateReservedEntityCommand<std::decay_t<Cs>...>>(m_sortKey, ent, std::in_place, std::forward<Cs>(data)...);
+            return ent;
+        }
+
         CCommands& destroyEntity(entityid_t ent)
         {
-            m_queue.insert(CDestroyEntityCommand(ent));
+            m_queue.insert(CDestroyEntityCommand(ent), m_sortKey);
             return *this;
         }
 
         template<class C>
         CCommands& createOrUpdateComponent(entityid_t ent, C&& data)
         {
-            m_queue.insert(CCreateOrUpdateComponentCommand(ent, std::forward<C>(data)));
+            m_queue.emplace<CCreateOrUpdateComponentCommand<std::decay_t<C>>>(m_sortKey, ent, std::in_place, std::forward<C>(data));
+            return *this;
+        }
+
+        /**
+         * @brief Same as createOrUpdateComponent, but the component is constructed from args directly in the command queue
+         * 
+         * @details
+         * On execution the component is moved straight into the storage, so it's never copied.
+         * Useful for large components.
+         * 
+         * @tparam C type of the component
+         * @param ent entity ID
+         * @param args arguments for C's constructor or its aggregate initialization
+         */
+        template<class C, typename... Args>
+        CCommands& emplaceComponent(entityid_t ent, Args&&... args)
+        {
+            m_queue.emplace<CCreateOrUpdateComponentCommand<C>>(m_sortKey, ent, std::in_place, std::forward<Args>(args)...);
             return *this;
         }
 
         template<class C, class F>
         CCommands& updateComponent(entityid_t ent, F&& updater)
         {
-            m_queue.insert(CUpdateComponentCommand<C, F>(ent, std::forward<F>(updater)));
+            m_queue.insert(CUpdateComponentCommand<C, F>(ent, std::forward<F>(updater)), m_sortKey);
             return *this;
         }
 
         template<class C>
         CCommands& destroyComponent(entityid_t ent)
         {
-            m_queue.insert(CDestroyComponentCommand<C>(ent));
+            m_queue.insert(CDestroyComponentCommand<C>(ent), m_sortKey);
             return *this;
         }
 
@@ -257,4 +431,72 @@ namespace chestnut::ecs
     };  
 
 
+
+    /**
+     * @brief Set of command recorders, one for each thread of the thread pool
+     * 
+     * @details
+     * Handlers running on the pool record commands through local() without any locking.
+     * Thread that doesn't belong to the pool shares recorder with the thread that waits on it,
+     * so only one such thread may record at a time.
+     * 
+     * Commands are executed ordered by (sort key, thread slot, recording order). 
+     * All keys are 0 by default, in which case commands of thread slot 0 go first, then of slot 1 and so on,
+     * each slot's commands in the order they were recorded.
+     * Which thread processes which entities varies from run to run though, 
+     * so for reproducible results give commands sort keys, e.g. the entity they were recorded for.
+     * Execution then follows the keys, no matter which thread recorded the command.
+     */
+    class CParallelCommands
+    {
+    private:
+        // padded to keep threads from writing to the same cache line
+        struct alignas(64) SThreadCommands
+        {
+            CCommands commands;
+        };
+
+        CThreadPool& m_threadPool;
+        std::vector<SThreadCommands> m_vecThreadCommands;
+
+    public:
+        explicit CParallelCommands(CThreadPool& threadPool = CThreadPool::getDefault())
+        : m_threadPool(threadPool), m_vecThreadCommands(threadPool.getThreadSlotCount())
+        {
+
+        }
+
+        CParallelCommands(const CParallelCommands&) = delete;
+        CParallelCommands& operator=(const CParallelCommands&) = delete;
+
+        // Commands of the calling thread
+        CCommands& local()
+        {
+            return m_vecThreadCommands[m_threadPool.currentThreadSlot()].commands;
+        }
+
+        // Executes commands of all threads ordered by sort key, then by thread slot and then by recording order
+        void execute(CEntityWorld& world)
+        {
+            std::vector<CCommandQueue *> queues;
+            queues.reserve(m_vecThreadCommands.size());
+            for(SThreadCommands& threadCommands : m_vecThreadCommands)
+            {
+                queues.push_back(&threadCommands.commands.getCommandQueue());
+            }
+
+            CCommandQueue::executeMerged(queues.data(), queues.size(), world);
+        }
+
+        CParallelCommands& clear()
+        {
+            for(SThreadCommands& threadCommands : m_vecThreadCommands)
+            {
+                threadCommands.commands.clear();
+            }
+            return *this;
+        }
+    };
+
+
 } // namespace chestnut::ecs
@@ -1,24 +1,49 @@
 #pragma once
 
+#include "archetype_storage.hpp"
 #include "sparse_set.hpp"
 #include "types.hpp"
+#include "component_type_family.hpp"
 #include "entity_signature.hpp"
 
+#include <cstdint>
 #include <memory>
-#include <typeindex>
-#include <unordered_map>
+#include <vector>
+
+namespace chestnut::ecs
+{
+    /**
+     * @brief Layout in which the world keeps components of its entities
+     */
+    enum class EComponentStorageBackend
+    {
+        // one sparse set per component type; cheap adding and removing of components
+        SPARSE_SET,
+        // one table per distinct entity signature; fast iteration over queries joining many types
+        ARCHETYPE
+    };
+
+} // namespace chestnut::ecs
 
 namespace chestnut::ecs::internal
 {
     class CComponentStorage
     {
     private:
-        mutable std::unordered_map<std::type_index, std::unique_ptr<CSparseSetBase>> m_mapTypeToSparseSet;
+        EComponentStorageBackend m_backend;
+
+        // used only with the ARCHETYPE backend
+        CArchetypeStorage m_archetypes;
+
+        // sparse sets indexed by component type ID, null if the type hasn't been used in this storage yet
+        mutable std::vector<std::unique_ptr<CSparseSetBase>> m_vecSparseSets;
+        // signatures of entities that own at least one component, kept up to date on every insert and erase
+        CSparseSet<CEntitySignature> m_entitySignatures;
         entityid_t m_highestId;
 
 
     public:
-        CComponentStorage();
+        CComponentStorage(EComponentStorageBackend backend = EComponentStorageBackend::SPARSE_SET);
         ~CComponentStorage();
 
         //TODO2.0 use optional/result instead of exceptions
@@ -48,17 +73,45 @@ namespace chestnut::ecs::internal
         template<typename T>
         void insert(entityid_t id) noexcept;
 
+        // makes room for that many more components of the type; no-op with the ARCHETYPE backend,
+        // where the destination table isn't known until insertion
+        template<typename T>
+        void reserve(entitysize_t additional) noexcept;
+
         template<typename T>
         void erase(entityid_t id) noexcept;
 
 
+        // erases only from sparse sets of components the entity owns
         void eraseAll(entityid_t id) noexcept;
 
+        // erases all components of many entities, each sparse set is visited once with the entities that own its component
+        void eraseAll(const entityid_t *ids, entitysize_t count) noexcept;
+
+        // O(1), the signature is cached
         CEntitySignature signature(entityid_t id) const noexcept;
 
+        // key by which entities can be sorted to follow the memory order of their components of given type;
+        // entities without the component come last
+        uint64_t storageOrder(entityid_t id, componenttypeid_t typeId) const noexcept;
+
+
+        EComponentStorageBackend backend() const noexcept;
+
+        // sparse set of the component type for direct access, null with the ARCHETYPE backend
+        template<typename T>
+        CSparseSet<T> *sparseSetPtr() const noexcept;
+
+        // tables of the ARCHETYPE backend, empty with the other one
+        CArchetypeStorage& archetypes() noexcept;
+        const CArchetypeStorage& archetypes() const noexcept;
+
     private:
         template<typename T>
         CSparseSet<T>& getSparseSet() const noexcept;
+
+        void addToSignature(entityid_t id, componenttypeid_t typeId) noexcept;
+        void removeFromSignature(entityid_t id, componenttypeid_t typeId) noexcept;
     };
 
 } // namespace chestnut::ecs::internal
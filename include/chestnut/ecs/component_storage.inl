@@ -3,7 +3,8 @@
 namespace chestnut::ecs::internal
 {
 
-inline CComponentStorage::CComponentStorage() 
+inline CComponentStorage::CComponentStorage(EComponentStorageBackend backend) 
+: m_backend(backend)
 {
     m_highestId = ENTITY_ID_MINIMAL;
 }
@@ -19,37 +20,71 @@ inline CComponentStorage::~CComponentStorage()
 template<typename T>
 inline T& CComponentStorage::at(entityid_t id) 
 {
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return m_archetypes.at<T>(id);
+    }
+
     return getSparseSet<T>().at(id);
 }
 
 template<typename T>
 inline const T& CComponentStorage::at(entityid_t id) const
 {
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return m_archetypes.at<T>(id);
+    }
+
     return getSparseSet<T>().at(id);
 }
 
 template<typename T>
 inline bool CComponentStorage::empty() const noexcept
 {
-    return getSparseSet<T>().empty();
+    return size<T>() == 0;
 }
 
 template<typename T>
 inline entitysize_t CComponentStorage::size() const noexcept
 {
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return m_archetypes.size<T>();
+    }
+
     return (entitysize_t)getSparseSet<T>().size();
 }
 
 template<typename T>
 inline bool CComponentStorage::contains(entityid_t id) const noexcept
 {
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return m_archetypes.contains<T>(id);
+    }
+
     return getSparseSet<T>().contains(id);
 }
 
 template<typename T>
 inline void CComponentStorage::clear() noexcept
 {
-    getSparseSet<T>().clear();
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        m_archetypes.clear<T>();
+        return;
+    }
+
+    CSparseSet<T>& sparseSet = getSparseSet<T>();
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
+
+    for(entityid_t id : sparseSet.denseIndices())
+    {
+        removeFromSignature(id, typeId);
+    }
+
+    sparseSet.clear();
 }
 
 template<typename T>
@@ -59,8 +94,21 @@ inline void CComponentStorage::insert(entityid_t id, T&& arg) noexcept
     {
         m_highestId = id;
     }
+
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        m_archetypes.insert<T>(id, std::forward<T>(arg));
+        return;
+    }
+    
+    CSparseSet<T>& sparseSet = getSparseSet<T>();
+
+    if(!sparseSet.contains(id))
+    {
+        addToSignature(id, CComponentTypeFamily::id<T>());
+    }
     
-    getSparseSet<T>().insert(id, std::forward<T>(arg));
+    sparseSet.insert(id, std::forward<T>(arg));
 }
 
 template<typename T>
@@ -69,29 +117,54 @@ inline void CComponentStorage::insert(entityid_t id) noexcept
     this->insert(id, T());
 }
 
+template<typename T>
+inline void CComponentStorage::reserve(entitysize_t additional) noexcept
+{
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return;
+    }
+
+    CSparseSet<T>& sparseSet = getSparseSet<T>();
+    sparseSet.reserve(sparseSet.size() + additional);
+    m_entitySignatures.reserve(m_entitySignatures.size() + additional);
+}
+
 template<typename T>
 inline void CComponentStorage::erase(entityid_t id) noexcept
 {
-    getSparseSet<T>().erase(id);
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        m_archetypes.erase<T>(id);
+        return;
+    }
+
+    CSparseSet<T>& sparseSet = getSparseSet<T>();
+
+    if(sparseSet.contains(id))
+    {
+        removeFromSignature(id, CComponentTypeFamily::id<T>());
+        sparseSet.erase(id);
+    }
 }
 
 template<typename T>
 inline CSparseSet<T>& CComponentStorage::getSparseSet() const noexcept
 {
-    const auto TYPE_INDEX = std::type_index(typeid(T));
+    const componenttypeid_t typeId = CComponentTypeFamily::id<T>();
 
-    CSparseSet<T> *sparseSetPtr;
-    if(m_mapTypeToSparseSet.find(TYPE_INDEX) == m_mapTypeToSparseSet.end())
+    if(typeId >= m_vecSparseSets.size())
     {
-        sparseSetPtr = new CSparseSet<T>();
-        m_mapTypeToSparseSet[TYPE_INDEX] = std::move(std::unique_ptr<CSparseSet<T>>(sparseSetPtr));
+        m_vecSparseSets.resize(typeId + 1);
     }
-    else
+
+    std::unique_ptr<CSparseSetBase>& sparseSetPtr = m_vecSparseSets[typeId];
+    if(!sparseSetPtr)
     {
-        sparseSetPtr = static_cast<CSparseSet<T> *>(m_mapTypeToSparseSet[TYPE_INDEX].get());
+        sparseSetPtr = std::make_unique<CSparseSet<T>>();
     }
 
-    return *sparseSetPtr;
+    return *static_cast<CSparseSet<T> *>(sparseSetPtr.get());
 }
 
 
@@ -99,25 +172,145 @@ inline CSparseSet<T>& CComponentStorage::getSparseSet() const noexcept
 
 inline void CComponentStorage::eraseAll(entityid_t id) noexcept
 {
-    for(const auto& [typeIndex, sparseSetBase] : m_mapTypeToSparseSet)
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
     {
-        sparseSetBase->erase(id);
-    }   
+        m_archetypes.eraseAll(id);
+        return;
+    }
+
+    if(!m_entitySignatures.contains(id))
+    {
+        return;
+    }
+
+    m_entitySignatures.at(id).forEachType([this, id](componenttypeid_t typeId) {
+        m_vecSparseSets[typeId]->erase(id);
+    });
+
+    m_entitySignatures.erase(id);
 }
 
-inline CEntitySignature CComponentStorage::signature(entityid_t id) const noexcept
+inline void CComponentStorage::eraseAll(const entityid_t *ids, entitysize_t count) noexcept
 {
-    CEntitySignature sign;
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        for(entitysize_t i = 0; i < count; i++)
+        {
+            m_archetypes.eraseAll(ids[i]);
+        }
+        return;
+    }
+
+    // bucket entities by the component types they own
+    std::vector<std::vector<entityid_t>> vecTypeIdToEntities(m_vecSparseSets.size());
+    for(entitysize_t i = 0; i < count; i++)
+    {
+        const entityid_t id = ids[i];
+        if(m_entitySignatures.contains(id))
+        {
+            m_entitySignatures.at(id).forEachType([&vecTypeIdToEntities, id](componenttypeid_t typeId) {
+                vecTypeIdToEntities[typeId].push_back(id);
+            });
+        }
+    }
 
-    for(const auto& [typeIndex, sparseSetBase] : m_mapTypeToSparseSet)
+    for(componenttypeid_t typeId = 0; typeId < vecTypeIdToEntities.size(); typeId++)
     {
-        if(sparseSetBase->contains(id))
+        const std::vector<entityid_t>& entities = vecTypeIdToEntities[typeId];
+        if(!entities.empty())
         {
-            sign.add(typeIndex);
+            m_vecSparseSets[typeId]->eraseMany(entities.data(), (CSparseSetBase::index_type)entities.size());
         }
     }
 
-    return sign;
+    m_entitySignatures.eraseMany(ids, count);
+}
+
+inline CEntitySignature CComponentStorage::signature(entityid_t id) const noexcept
+{
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        const CArchetype *arch = m_archetypes.archetypeOf(id);
+        return arch ? arch->m_signature : CEntitySignature();
+    }
+
+    if(m_entitySignatures.contains(id))
+    {
+        return m_entitySignatures.at(id);
+    }
+
+    return CEntitySignature();
+}
+
+inline uint64_t CComponentStorage::storageOrder(entityid_t id, componenttypeid_t typeId) const noexcept
+{
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        // all columns of a table share the same order
+        return m_archetypes.locationKey(id);
+    }
+
+    if(typeId >= m_vecSparseSets.size() || !m_vecSparseSets[typeId])
+    {
+        return UINT64_MAX;
+    }
+
+    // NIL_INDEX turns into the highest possible key
+    return (uint64_t)(uint32_t)m_vecSparseSets[typeId]->sparse()[id];
+}
+
+inline EComponentStorageBackend CComponentStorage::backend() const noexcept
+{
+    return m_backend;
+}
+
+template<typename T>
+inline CSparseSet<T> *CComponentStorage::sparseSetPtr() const noexcept
+{
+    if(m_backend == EComponentStorageBackend::ARCHETYPE)
+    {
+        return nullptr;
+    }
+
+    return &getSparseSet<T>();
+}
+
+inline CArchetypeStorage& CComponentStorage::archetypes() noexcept
+{
+    return m_archetypes;
+}
+
+inline const CArchetypeStorage& CComponentStorage::archetypes() const noexcept
+{
+    return m_archetypes;
+}
+
+inline void CComponentStorage::addToSignature(entityid_t id, componenttypeid_t typeId) noexcept
+{
+    if(m_entitySignatures.contains(id))
+    {
+        m_entitySignatures.at(id).add(typeId);
+    }
+    else
+    {
+        CEntitySignature sign;
+        sign.add(typeId);
+        m_entitySignatures.insert(id, std::move(sign));
+    }
+}
+
+inline void CComponentStorage::removeFromSignature(entityid_t id, componenttypeid_t typeId) noexcept
+{
+    if(m_entitySignatures.contains(id))
+    {
+        CEntitySignature& sign = m_entitySignatures.at(id);
+        sign.remove(typeId);
+
+        if(sign.isEmpty())
+        {
+            m_entitySignatures.erase(id);
+        }
+    }
 }
 
 } // namespace chestnut::ecs::internal
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <shared_mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace chestnut::ecs::internal
+{
+    /**
+     * @brief Class that assigns dense integer IDs to component types
+     *
+     * @details
+     * IDs are handed out from a process-wide counter the first time a type is used.
+     * The templated id<T>() caches the result in a function-local static, so after the first call
+     * it costs a single load. Runtime std::type_index lookups go through a shared map
+     * and should be kept out of hot paths.
+     * 
+     * At most MAX_COMPONENT_TYPES types can be given IDs. Using one more aborts the program
+     * with a message naming that type, so that every assigned ID fits into CEntitySignature.
+     */
+    class CComponentTypeFamily
+    {
+    private:
+        struct SRegistry
+        {
+            std::shared_mutex mutex;
+            std::unordered_map<std::type_index, componenttypeid_t> mapTypeToId;
+            std::vector<std::type_index> vecIdToType;
+        };
+
+    public:
+        /**
+         * @brief Returns the ID of type T, assigns a new one if T hasn't been used yet
+         * 
+         * @details Aborts if T would be the type over MAX_COMPONENT_TYPES limit
+         */
+        template<typename T>
+        static componenttypeid_t id() noexcept;
+
+        /**
+         * @brief Returns the ID of given type, assigns a new one if the type hasn't been used yet
+         */
+        static componenttypeid_t id(std::type_index type) noexcept;
+
+        /**
+         * @brief Returns the ID of given type or COMPONENT_TYPE_ID_INVALID if the type hasn't been used yet
+         */
+        static componenttypeid_t find(std::type_index type) noexcept;
+
+        /**
+         * @brief Returns the type that has been assigned given ID
+         *
+         * @throws std::out_of_range if ID hasn't been assigned
+         */
+        static std::type_index type(componenttypeid_t id);
+
+        /**
+         * @brief Returns the amount of IDs assigned so far
+         */
+        static componenttypeid_t count() noexcept;
+
+    private:
+        static SRegistry& registry() noexcept;
+    };
+
+} // namespace chestnut::ecs::internal
+
+
+#include "component_type_family.inl"
@@ -0,0 +1,91 @@
+#include "constants.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+namespace chestnut::ecs::internal
+{
+
+template<typename T>
+componenttypeid_t CComponentTypeFamily::id() noexcept
+{
+    static const componenttypeid_t s_id = id(std::type_index(typeid(T)));
+    return s_id;
+}
+
+inline componenttypeid_t CComponentTypeFamily::id(std::type_index type) noexcept
+{
+    SRegistry& reg = registry();
+
+    {
+        std::shared_lock lock(reg.mutex);
+
+        auto it = reg.mapTypeToId.find(type);
+        if(it != reg.mapTypeToId.end())
+        {
+            return it->second;
+        }
+    }
+
+    std::unique_lock lock(reg.mutex);
+
+    // another thread could've assigned the ID in the meantime
+    auto it = reg.mapTypeToId.find(type);
+    if(it != reg.mapTypeToId.end())
+    {
+        return it->second;
+    }
+
+    const componenttypeid_t newId = (componenttypeid_t)reg.vecIdToType.size();
+    if(newId >= MAX_COMPONENT_TYPES)
+    {
+        // IDs are used as signature bit indices, there's no way to carry on with one that doesn't fit
+        std::fprintf(stderr, "chestnut-ecs: component type %s exceeds the limit of %u component types, "
+                             "define CHESTNUT_ECS_MAX_COMPONENT_TYPES to raise it\n", type.name(), (unsigned int)MAX_COMPONENT_TYPES);
+        std::abort();
+    }
+
+    reg.mapTypeToId.emplace(type, newId);
+    reg.vecIdToType.push_back(type);
+
+    return newId;
+}
+
+inline componenttypeid_t CComponentTypeFamily::find(std::type_index type) noexcept
+{
+    SRegistry& reg = registry();
+    std::shared_lock lock(reg.mutex);
+
+    auto it = reg.mapTypeToId.find(type);
+    if(it != reg.mapTypeToId.end())
+    {
+        return it->second;
+    }
+
+    return COMPONENT_TYPE_ID_INVALID;
+}
+
+inline std::type_index CComponentTypeFamily::type(componenttypeid_t id)
+{
+    SRegistry& reg = registry();
+    std::shared_lock lock(reg.mutex);
+
+    return reg.vecIdToType.at(id);
+}
+
+inline componenttypeid_t CComponentTypeFamily::count() noexcept
+{
+    SRegistry& reg = registry();
+    std::shared_lock lock(reg.mutex);
+
+    return (componenttypeid_t)reg.vecIdToType.size();
+}
+
+inline CComponentTypeFamily::SRegistry& CComponentTypeFamily::registry() noexcept
+{
+    static SRegistry s_registry;
+    return s_registry;
+}
+
+} // namespace chestnut::ecs::internal
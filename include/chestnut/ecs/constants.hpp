@@ -27,5 +27,23 @@ namespace chestnut::ecs
      * @brief Constant for the minimal value entity ID can take
      */
     const entityid_t ENTITY_ID_MINIMAL = 0;
+
+    /**
+     * @brief Constant reserved for invalid component type ID
+     */
+    const componenttypeid_t COMPONENT_TYPE_ID_INVALID = std::numeric_limits<componenttypeid_t>::max();
+
+#ifndef CHESTNUT_ECS_MAX_COMPONENT_TYPES
+    #define CHESTNUT_ECS_MAX_COMPONENT_TYPES 128
+#endif
+
+    /**
+     * @brief Constant for the maximal number of distinct component types; it's the width of the entity signature bitset
+     * 
+     * @details Can be changed by defining CHESTNUT_ECS_MAX_COMPONENT_TYPES as a multiple of 64 before including the library
+     */
+    const componenttypeid_t MAX_COMPONENT_TYPES = CHESTNUT_ECS_MAX_COMPONENT_TYPES;
+
+    static_assert(MAX_COMPONENT_TYPES % 64 == 0, "CHESTNUT_ECS_MAX_COMPONENT_TYPES must be a multiple of 64");
     
 } // namespace chestnut::ecs
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "archetype_storage.hpp"
 #include "component_handle.hpp"
 #include "component_storage.hpp"
+#include "component_type_family.hpp"
 #include "constants.hpp"
+#include "entity_handle.hpp"
 #include "entity_iterator.hpp"
 #include "entity_query_guard.hpp"
 #include "entity_query.hpp"
@@ -10,5 +13,7 @@
 #include "entity_signature.hpp"
 #include "entity_world.hpp"
 #include "exceptions.hpp"
+#include "paged_sparse_array.hpp"
 #include "sparse_set.hpp"
+#include "thread_pool.hpp"
 #include "types.hpp"
@@ -0,0 +1,53 @@
+/**
+ * @file entity_handle.hpp
+ * @author Przemysław Cedro (SpontanCombust)
+ * @brief Header file for the versioned entity handle
+ * @version 1.0
+ * @date 2026-10-17
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+
+#pragma once
+
+#include "types.hpp"
+#include "constants.hpp"
+
+namespace chestnut::ecs
+{
+    /**
+     * @brief 64-bit handle to an entity that consists of its ID and the version of that ID
+     * 
+     * @details
+     * Entity IDs get recycled, so a plain entityid_t kept around after the entity got destroyed
+     * can end up pointing to a completely different entity. The version of an ID is incremented
+     * every time an entity with that ID is destroyed, so a stale handle is rejected 
+     * by a single comparison of versions.
+     */
+    struct SEntityHandle
+    {
+        entityid_t id = ENTITY_ID_INVALID;
+        entityversion_t version = 0;
+    };
+
+    /**
+     * @brief Constant for the handle that doesn't point to any entity
+     */
+    const SEntityHandle ENTITY_HANDLE_INVALID = SEntityHandle{ ENTITY_ID_INVALID, 0 };
+
+
+    inline bool operator==( const SEntityHandle& lhs, const SEntityHandle& rhs )
+    {
+        return lhs.id == rhs.id && lhs.version == rhs.version;
+    }
+
+    inline bool operator!=( const SEntityHandle& lhs, const SEntityHandle& rhs )
+    {
+        return !( lhs == rhs );
+    }
+
+    static_assert(sizeof(SEntityHandle) == 8, "SEntityHandle should fit into 64 bits");
+
+} // namespace chestnut::ecs
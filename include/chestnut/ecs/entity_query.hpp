@@ -3,8 +3,11 @@
 #include "types.hpp"
 #include "component_storage.hpp"
 #include "entity_signature.hpp"
+#include "paged_sparse_array.hpp"
+#include "thread_pool.hpp"
 
 #include <functional>
+#include <tuple>
 #include <vector>
 
 namespace chestnut::ecs
@@ -26,6 +29,27 @@ namespace chestnut::ecs
         template<typename ...Types>
         friend struct Iterator;
 
+        /**
+         * @brief Batch of consecutive query entities passed to forEachChunk
+         * 
+         * @details
+         * Component of the i-th entity in the chunk is the i-th element of the array for its type.
+         * Arrays are valid only for the duration of the callback.
+         */
+        template<typename ...Types>
+        struct Chunk
+        {
+            unsigned int count;
+            const entityid_t *entityIds;
+            std::tuple<Types*...> components;
+
+            template<typename T>
+            T *get() const noexcept
+            {
+                return std::get<T*>(components);
+            }
+        };
+
     private:
         internal::CComponentStorage *m_storagePtr;
 
@@ -33,6 +57,13 @@ namespace chestnut::ecs
         CEntitySignature m_rejectSignature;
 
         std::vector< entityid_t > m_vecEntityIDs;
+        // index of each entity in m_vecEntityIDs, lets the guard remove entities without searching
+        internal::CPagedSparseArray m_entitySlots;
+
+        // set when entities were enqueued or dequeued by the guard since the last update
+        bool m_isOutdated;
+        // set when the user has sorted the query, in which case entity order has to be preserved
+        bool m_isSorted;
 
 
     public:
@@ -53,12 +84,79 @@ namespace chestnut::ecs
         Iterator<Types...> end();
 
 
-        template<typename ...Types>
-        void forEach(const std::function<void(Types&...)>& handler);
+        /**
+         * @brief Calls the handler with references to components of every entity in the query
+         * 
+         * @details Handler can be any callable taking Types&..., e.g. a lambda or a std::function.
+         * Types are validated once per call.
+         * 
+         * @tparam Types component types to iterate over
+         * @param handler callable taking references to components
+         * 
+         * @throws QueryException if types aren't in the 'require' signature or are in the 'reject' signature
+         */
+        template<typename ...Types, typename F>
+        void forEach(F&& handler);
+
+        /**
+         * @brief Calls the handler with references to components of every entity in the query, 
+         * splitting the work between threads of the pool
+         * 
+         * @details
+         * Entities are split into chunks of grainSize that are processed in parallel,
+         * so the handler must be safe to call concurrently for different entities.
+         * Don't add or remove components or entities from inside the handler.
+         * 
+         * @tparam Types component types to iterate over
+         * @param handler callable taking references to components
+         * @param grainSize number of entities processed by a single task
+         * @param threadPool pool to run on
+         * 
+         * @throws QueryException if types aren't in the 'require' signature or are in the 'reject' signature
+         */
+        template<typename ...Types, typename F>
+        void parallelForEach(F&& handler, unsigned int grainSize = 256, CThreadPool& threadPool = CThreadPool::getDefault());
+
+
+        /**
+         * @brief Calls the handler with batches of up to maxChunkSize entities and arrays of their components
+         * 
+         * @details
+         * Where entities in the chunk own consecutive elements of component storage, arrays point directly into it.
+         * Otherwise components are moved into a scratch buffer and moved back after the handler returns,
+         * so inside the handler components of the chunk's entities should be accessed only through the chunk.
+         * 
+         * @tparam Types component types to iterate over
+         * @param handler callable taking Chunk<Types...>
+         * @param maxChunkSize maximum number of entities in a chunk
+         * 
+         * @throws QueryException if types aren't in the 'require' signature or are in the 'reject' signature
+         */
+        template<typename ...Types, typename F>
+        void forEachChunk(F&& handler, unsigned int maxChunkSize = 256);
 
 
         template<typename ...Types>
         void sort(std::function<bool(Iterator<Types...>, Iterator<Types...>)> comparator) noexcept;
+
+    private:
+        // throws QueryException if types can't be iterated over with this query
+        template<typename ...Types>
+        void validateIteratedTypes() const;
+
+        // returns pointer into the sparse set if components of the entities lie next to each other, otherwise moves them into scratch
+        template<typename T>
+        T *gatherChunk(internal::CSparseSet<T> *sparseSet, const entityid_t *ids, unsigned int count, std::vector<T>& scratch);
+
+        // moves components back from scratch if they were gathered there
+        template<typename T>
+        void scatterChunk(internal::CSparseSet<T> *sparseSet, const entityid_t *ids, unsigned int count, std::vector<T>& scratch, T *components);
+
+        // recomputes m_entitySlots after entity order was changed wholesale
+        void rebuildEntitySlots() noexcept;
+
+        // true if query holds exactly the entities of matching archetypes and can walk their tables directly
+        bool canIterateArchetypes() const noexcept;
     };
 
 } // namespace chestnut::ecs
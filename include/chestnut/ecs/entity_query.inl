@@ -1,13 +1,15 @@
 #include "exceptions.hpp"
 
-#include <algorithm> // stable_sort
+#include <algorithm> // stable_sort, min
 #include <numeric> // iota
+#include <type_traits> // is_empty_v
+#include <utility> // move
 
 namespace chestnut::ecs
 {
 
 inline CEntityQuery::CEntityQuery(internal::CComponentStorage *storagePtr, CEntitySignature requireSignature, CEntitySignature rejectSignature) noexcept
-: m_storagePtr(storagePtr), m_requireSignature(requireSignature), m_rejectSignature(rejectSignature)
+: m_storagePtr(storagePtr), m_requireSignature(requireSignature), m_rejectSignature(rejectSignature), m_isOutdated(false), m_isSorted(false)
 {
 
 }
@@ -38,47 +40,199 @@ inline entitysize_t CEntityQuery::getEntityCount() const noexcept
 template<typename ...Types>
 CEntityQuery::Iterator<Types...> CEntityQuery::begin()
 {
-    if(!m_requireSignature.has<Types...>())
+    validateIteratedTypes<Types...>();
+
+    return Iterator<Types...>(this, 0);
+}
+
+template<typename ...Types>
+CEntityQuery::Iterator<Types...> CEntityQuery::end()
+{
+    validateIteratedTypes<Types...>();
+
+    return Iterator<Types...>(this, (unsigned int)m_vecEntityIDs.size());
+}
+
+
+
+template<typename ...Types, typename F>
+void CEntityQuery::forEach(F&& handler)
+{
+    validateIteratedTypes<Types...>();
+
+    if(canIterateArchetypes())
     {
-        throw QueryException("All types supplied must be in query's 'require' signature");
+        m_storagePtr->archetypes().forEachMatchingArchetype(m_requireSignature, m_rejectSignature, 
+        [&handler](internal::CArchetype& arch) {
+            std::tuple<Types*...> columns(arch.column<Types>()->m_data.data()...);
+            const unsigned int rowCount = arch.size();
+
+            std::apply([&handler, rowCount](Types*... column) {
+                for(unsigned int row = 0; row < rowCount; row++)
+                {
+                    handler(column[row]...);
+                }
+            }, columns);
+        });
+
+        return;
     }
 
-    CEntitySignature sign = makeEntitySignature<Types...>();
+    const entityid_t *ids = m_vecEntityIDs.data();
+    const unsigned int entityCount = (unsigned int)m_vecEntityIDs.size();
 
-    if(m_rejectSignature.hasAnyFrom(sign))
+    if(m_storagePtr->backend() == EComponentStorageBackend::SPARSE_SET)
     {
-        throw QueryException("None of the supplied types should be in query's 'reject' signature");
-    }
+        std::tuple<internal::CSparseSet<Types> *...> sparseSets(m_storagePtr->sparseSetPtr<Types>()...);
 
-    return Iterator<Types...>(this, 0);
+        std::apply([&handler, ids, entityCount](internal::CSparseSet<Types> *... sparseSet) {
+            for(unsigned int i = 0; i < entityCount; i++)
+            {
+                handler(sparseSet->at(ids[i])...);
+            }
+        }, sparseSets);
+    }
+    else
+    {
+        for(unsigned int i = 0; i < entityCount; i++)
+        {
+            handler(m_storagePtr->at<Types>(ids[i])...);
+        }
+    }
 }
 
-template<typename ...Types>
-CEntityQuery::Iterator<Types...> CEntityQuery::end()
+
+
+template<typename ...Types, typename F>
+void CEntityQuery::parallelForEach(F&& handler, unsigned int grainSize, CThreadPool& threadPool)
 {
-    if(!m_requireSignature.has<Types...>())
+    validateIteratedTypes<Types...>();
+
+    if(grainSize == 0)
     {
-        throw QueryException("All types supplied must be in query's 'require' signature");
+        grainSize = 1;
     }
 
-    CEntitySignature sign = makeEntitySignature<Types...>();
+    if(canIterateArchetypes())
+    {
+        struct SRowRange
+        {
+            internal::CArchetype *arch;
+            unsigned int begin;
+            unsigned int end;
+        };
 
-    if(m_rejectSignature.hasAnyFrom(sign))
+        std::vector<SRowRange> ranges;
+        m_storagePtr->archetypes().forEachMatchingArchetype(m_requireSignature, m_rejectSignature, 
+        [&ranges, grainSize](internal::CArchetype& arch) {
+            for(unsigned int begin = 0; begin < arch.size(); begin += grainSize)
+            {
+                ranges.push_back({&arch, begin, std::min(begin + grainSize, arch.size())});
+            }
+        });
+
+        threadPool.parallelFor((unsigned int)ranges.size(), [&handler, &ranges](unsigned int taskIdx) {
+            const SRowRange& range = ranges[taskIdx];
+            std::tuple<Types*...> columns(range.arch->template column<Types>()->m_data.data()...);
+
+            std::apply([&handler, &range](Types*... column) {
+                for(unsigned int row = range.begin; row < range.end; row++)
+                {
+                    handler(column[row]...);
+                }
+            }, columns);
+        });
+
+        return;
+    }
+
+    const entityid_t *ids = m_vecEntityIDs.data();
+    const unsigned int entityCount = (unsigned int)m_vecEntityIDs.size();
+    const unsigned int taskCount = (entityCount + grainSize - 1) / grainSize;
+
+    if(m_storagePtr->backend() == EComponentStorageBackend::SPARSE_SET)
     {
-        throw QueryException("None of the supplied types should be in query's 'reject' signature");
+        // resolved up front, so that tasks only read from the storage
+        std::tuple<internal::CSparseSet<Types> *...> sparseSets(m_storagePtr->sparseSetPtr<Types>()...);
+
+        threadPool.parallelFor(taskCount, [&handler, &sparseSets, ids, entityCount, grainSize](unsigned int taskIdx) {
+            const unsigned int begin = taskIdx * grainSize;
+            const unsigned int end = std::min(begin + grainSize, entityCount);
+
+            std::apply([&handler, ids, begin, end](internal::CSparseSet<Types> *... sparseSet) {
+                for(unsigned int i = begin; i < end; i++)
+                {
+                    handler(sparseSet->at(ids[i])...);
+                }
+            }, sparseSets);
+        });
     }
+    else
+    {
+        internal::CComponentStorage *storage = m_storagePtr;
 
-    return Iterator<Types...>(this, (unsigned int)m_vecEntityIDs.size());
+        threadPool.parallelFor(taskCount, [&handler, storage, ids, entityCount, grainSize](unsigned int taskIdx) {
+            const unsigned int begin = taskIdx * grainSize;
+            const unsigned int end = std::min(begin + grainSize, entityCount);
+
+            for(unsigned int i = begin; i < end; i++)
+            {
+                handler(storage->at<Types>(ids[i])...);
+            }
+        });
+    }
 }
 
 
 
-template<typename ...Types>
-void CEntityQuery::forEach(const std::function<void(Types&...)>& handler )
+template<typename ...Types, typename F>
+void CEntityQuery::forEachChunk(F&& handler, unsigned int maxChunkSize)
 {
-    for(auto it = this->begin<Types...>(); it != this->end<Types...>(); it++)
+    validateIteratedTypes<Types...>();
+
+    if(maxChunkSize == 0)
     {
-        std::apply(handler, *it);
+        maxChunkSize = 1;
+    }
+
+    if(canIterateArchetypes())
+    {
+        m_storagePtr->archetypes().forEachMatchingArchetype(m_requireSignature, m_rejectSignature, 
+        [&handler, maxChunkSize](internal::CArchetype& arch) {
+            const unsigned int rowCount = arch.size();
+
+            for(unsigned int begin = 0; begin < rowCount; begin += maxChunkSize)
+            {
+                handler(Chunk<Types...>{
+                    std::min(maxChunkSize, rowCount - begin),
+                    arch.m_vecEntityIDs.data() + begin,
+                    std::tuple<Types*...>(arch.column<Types>()->m_data.data() + begin...)
+                });
+            }
+        });
+
+        return;
+    }
+
+    const entityid_t *ids = m_vecEntityIDs.data();
+    const unsigned int entityCount = (unsigned int)m_vecEntityIDs.size();
+
+    std::tuple<internal::CSparseSet<Types> *...> sparseSets(m_storagePtr->sparseSetPtr<Types>()...);
+    std::tuple<std::vector<Types>...> scratches;
+
+    for(unsigned int begin = 0; begin < entityCount; begin += maxChunkSize)
+    {
+        const unsigned int count = std::min(maxChunkSize, entityCount - begin);
+
+        Chunk<Types...> chunk{
+            count,
+            ids + begin,
+            std::tuple<Types*...>(gatherChunk<Types>(std::get<internal::CSparseSet<Types> *>(sparseSets), ids + begin, count, std::get<std::vector<Types>>(scratches))...)
+        };
+
+        handler(chunk);
+
+        (scatterChunk<Types>(std::get<internal::CSparseSet<Types> *>(sparseSets), ids + begin, count, std::get<std::vector<Types>>(scratches), chunk.template get<Types>()), ...);
     }
 }
 
@@ -90,10 +244,15 @@ void CEntityQuery::sort(std::function<bool(CEntityQuery::Iterator<Types...>, CEn
     std::vector<unsigned int> indices(m_vecEntityIDs.size());
     std::iota(indices.begin(), indices.end(), 0);
 
+    // copying the iterator doesn't resolve component storage again
+    const Iterator<Types...> first(this, 0);
+
     std::stable_sort(indices.begin(), indices.end(),
         [&](unsigned int idx1, unsigned int idx2) -> bool {
-            Iterator<Types...> it1(this, idx1);
-            Iterator<Types...> it2(this, idx2);
+            Iterator<Types...> it1 = first;
+            it1.m_currentQueryIdx = idx1;
+            Iterator<Types...> it2 = first;
+            it2.m_currentQueryIdx = idx2;
 
             return comparator(it1, it2);
         }
@@ -107,6 +266,94 @@ void CEntityQuery::sort(std::function<bool(CEntityQuery::Iterator<Types...>, CEn
     }
 
     this->m_vecEntityIDs = std::move(sortedEnts);
+    this->m_isSorted = true;
+    this->rebuildEntitySlots();
+}
+
+
+
+template<typename ...Types>
+void CEntityQuery::validateIteratedTypes() const
+{
+    if(!m_requireSignature.has<Types...>())
+    {
+        throw QueryException("All types supplied must be in query's 'require' signature");
+    }
+
+    CEntitySignature sign = makeEntitySignature<Types...>();
+
+    if(m_rejectSignature.hasAnyFrom(sign))
+    {
+        throw QueryException("None of the supplied types should be in query's 'reject' signature");
+    }
+}
+
+template<typename T>
+T *CEntityQuery::gatherChunk(internal::CSparseSet<T> *sparseSet, const entityid_t *ids, unsigned int count, std::vector<T>& scratch)
+{
+    if constexpr(std::is_empty_v<T>)
+    {
+        // tags have no data to gather, any array of them will do
+        scratch.resize(count);
+        return scratch.data();
+    }
+
+    if(sparseSet)
+    {
+        const int first = sparseSet->sparse()[ids[0]];
+        bool isContiguous = first != internal::CSparseSetBase::NIL_INDEX;
+
+        for(unsigned int i = 1; i < count && isContiguous; i++)
+        {
+            isContiguous = sparseSet->sparse()[ids[i]] == first + (int)i;
+        }
+
+        if(isContiguous)
+        {
+            return sparseSet->data() + first;
+        }
+    }
+
+    scratch.clear();
+    scratch.reserve(count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        scratch.push_back(std::move(sparseSet ? sparseSet->at(ids[i]) : m_storagePtr->at<T>(ids[i])));
+    }
+
+    return scratch.data();
+}
+
+template<typename T>
+void CEntityQuery::scatterChunk(internal::CSparseSet<T> *sparseSet, const entityid_t *ids, unsigned int count, std::vector<T>& scratch, T *components)
+{
+    if(std::is_empty_v<T> || components != scratch.data())
+    {
+        return;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        T& component = sparseSet ? sparseSet->at(ids[i]) : m_storagePtr->at<T>(ids[i]);
+        component = std::move(scratch[i]);
+    }
+}
+
+inline void CEntityQuery::rebuildEntitySlots() noexcept
+{
+    m_entitySlots.reset();
+
+    for(unsigned int i = 0; i < (unsigned int)m_vecEntityIDs.size(); i++)
+    {
+        m_entitySlots.set(m_vecEntityIDs[i], (int)i);
+    }
+}
+
+inline bool CEntityQuery::canIterateArchetypes() const noexcept
+{
+    // entities without any components don't belong to any archetype
+    return m_storagePtr->backend() == EComponentStorageBackend::ARCHETYPE 
+        && !m_requireSignature.isEmpty() && !m_isOutdated && !m_isSorted;
 }
 
 } // namespace chestnut::ecs
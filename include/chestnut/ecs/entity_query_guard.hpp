@@ -3,7 +3,8 @@
 #include "component_storage.hpp"
 #include "entity_query.hpp"
 
-#include <unordered_set>
+#include <cstdint>
+#include <vector>
 
 namespace chestnut::ecs
 {
@@ -16,6 +17,8 @@ namespace chestnut::ecs
         unsigned int added = 0;
         unsigned int removed = 0;
         unsigned int total = 0;
+        // cost of the update - how many entities had to be moved to another place in the query to fill gaps after removal
+        unsigned int moved = 0;
     };
 }
 
@@ -32,8 +35,18 @@ namespace chestnut::ecs::internal
     class CEntityQueryGuard
     {
     private:
-        std::unordered_set< entityid_t > m_pendingIn_setEntityIDs;
-        std::unordered_set< entityid_t > m_pendingOut_setEntityIDs;
+        // entities in the order they were enqueued/dequeued; may hold stale entries, 
+        // the bitmap tells what was the last thing that happened to the entity
+        std::vector< entityid_t > m_vecPendingInEntityIDs;
+        std::vector< entityid_t > m_vecPendingOutEntityIDs;
+        // bit for each entity ID; set if entity was enqueued after it was last dequeued
+        std::vector< uint64_t > m_vecPendingInBits;
+
+        // component type by which storage order is determined for new entities
+        componenttypeid_t m_orderTypeId;
+
+        // set when an open world batch changed entities the query may be interested in
+        bool m_hasBatchedChanges;
 
         CEntityQuery m_targetQuery;
 
@@ -42,17 +55,29 @@ namespace chestnut::ecs::internal
         CEntityQueryGuard(CComponentStorage *componentStorage, const CEntitySignature& requireSignature, const CEntitySignature& rejectSignature);
 
 
-        // Doesn't check for duplicates
+        // Don't allocate unless entity ID is higher than any seen before
+        // Entities already in the query or not in it are skipped when updating
         void enqueueEntity( entityid_t entityID );
         void dequeueEntity( entityid_t entityID );
 
+        void enqueueEntities( const entityid_t *entityIDs, entitysize_t count );
+        void dequeueEntities( const entityid_t *entityIDs, entitysize_t count );
+
         // Returns whether the content of the query changed after the update
         SEntityQueryUpdateInfo updateQuery();
 
+        // Until the batch ends the query is kept outdated, 
+        // so it iterates only entities it has been given and not what already is in the storage
+        void markBatchedChanges();
+        void clearBatchedChanges();
+
         bool testQuery( const CEntitySignature& signature ) const;
 
         const CEntityQuery& getQuery() const;
         CEntityQuery& getQuery();
+
+    private:
+        bool isPendingIn( entityid_t entityID ) const;
     };
 
 } // namespace chestnut::ecs::internal
@@ -1,69 +1,215 @@
+#include <algorithm> // sort
+
 namespace chestnut::ecs::internal
 {    
     inline CEntityQueryGuard::CEntityQueryGuard(CComponentStorage *componentStorage, const CEntitySignature& requireSignature, const CEntitySignature& rejectSignature)
-    : m_targetQuery(componentStorage, requireSignature, rejectSignature)
+    : m_orderTypeId(COMPONENT_TYPE_ID_INVALID), m_hasBatchedChanges(false), m_targetQuery(componentStorage, requireSignature, rejectSignature)
     {
-
+        // any required type will do, query iterates over all of them anyway
+        requireSignature.forEachType([this](componenttypeid_t typeId) {
+            if(m_orderTypeId == COMPONENT_TYPE_ID_INVALID)
+            {
+                m_orderTypeId = typeId;
+            }
+        });
     }
 
     inline void CEntityQueryGuard::enqueueEntity( entityid_t entityID ) 
     {
-        m_pendingOut_setEntityIDs.erase(entityID);
-        m_pendingIn_setEntityIDs.insert(entityID);
+        const size_t word = entityID / 64;
+        const uint64_t bit = (uint64_t)1 << (entityID % 64);
+
+        if(word >= m_vecPendingInBits.size())
+        {
+            m_vecPendingInBits.resize(word + 1, 0);
+        }
+
+        if(!(m_vecPendingInBits[word] & bit))
+        {
+            m_vecPendingInBits[word] |= bit;
+            m_vecPendingInEntityIDs.push_back(entityID);
+        }
+
+        m_targetQuery.m_isOutdated = true;
     }
 
     inline void CEntityQueryGuard::dequeueEntity( entityid_t entityID ) 
     {
-        m_pendingIn_setEntityIDs.erase(entityID);
-        m_pendingOut_setEntityIDs.insert(entityID);
+        const size_t word = entityID / 64;
+        const uint64_t bit = (uint64_t)1 << (entityID % 64);
+
+        if(word < m_vecPendingInBits.size())
+        {
+            m_vecPendingInBits[word] &= ~bit;
+        }
+
+        m_vecPendingOutEntityIDs.push_back(entityID);
+        m_targetQuery.m_isOutdated = true;
+    }
+
+    inline void CEntityQueryGuard::enqueueEntities( const entityid_t *entityIDs, entitysize_t count ) 
+    {
+        m_vecPendingInEntityIDs.reserve(m_vecPendingInEntityIDs.size() + count);
+
+        for(entitysize_t i = 0; i < count; i++)
+        {
+            enqueueEntity(entityIDs[i]);
+        }
+    }
+
+    inline void CEntityQueryGuard::dequeueEntities( const entityid_t *entityIDs, entitysize_t count ) 
+    {
+        m_vecPendingOutEntityIDs.reserve(m_vecPendingOutEntityIDs.size() + count);
+
+        for(entitysize_t i = 0; i < count; i++)
+        {
+            dequeueEntity(entityIDs[i]);
+        }
     }
 
     inline SEntityQueryUpdateInfo CEntityQueryGuard::updateQuery() 
     {
-        SEntityQueryUpdateInfo updateInfo {0, 0, 0};
+        SEntityQueryUpdateInfo updateInfo {0, 0, 0, 0};
+
+        std::vector<entityid_t>& entityIDs = m_targetQuery.m_vecEntityIDs;
+        CPagedSparseArray& entitySlots = m_targetQuery.m_entitySlots;
 
         // first do the removal
-        if(!m_pendingOut_setEntityIDs.empty())
+        if(!m_vecPendingOutEntityIDs.empty())
         {
-            for(auto it = m_targetQuery.m_vecEntityIDs.begin(); it != m_targetQuery.m_vecEntityIDs.end(); /*NOP*/)
+            if(!m_targetQuery.m_isSorted)
             {
-                if(m_pendingOut_setEntityIDs.find(*it) != m_pendingOut_setEntityIDs.end())
+                // order doesn't matter, fill the gap with the last entity
+                for(entityid_t entityID : m_vecPendingOutEntityIDs)
                 {
-                    m_pendingOut_setEntityIDs.erase(*it);
-                    it = m_targetQuery.m_vecEntityIDs.erase(it);
+                    const int slot = entitySlots[entityID];
+                    if(slot == CPagedSparseArray::NIL_INDEX || isPendingIn(entityID))
+                    {
+                        continue;
+                    }
+
+                    const entityid_t lastEntityID = entityIDs.back();
+                    if(lastEntityID != entityID)
+                    {
+                        entityIDs[slot] = lastEntityID;
+                        entitySlots.set(lastEntityID, slot);
+                        updateInfo.moved++;
+                    }
+
+                    entityIDs.pop_back();
+                    entitySlots.set(entityID, CPagedSparseArray::NIL_INDEX);
                     updateInfo.removed++;
                 }
-                else
+            }
+            else
+            {
+                // keep the order user sorted the query in, compact the vector in a single pass
+                for(entityid_t entityID : m_vecPendingOutEntityIDs)
                 {
-                    it++;
+                    if(entitySlots[entityID] != CPagedSparseArray::NIL_INDEX && !isPendingIn(entityID))
+                    {
+                        entitySlots.set(entityID, CPagedSparseArray::NIL_INDEX);
+                        updateInfo.removed++;
+                    }
+                }
+
+                if(updateInfo.removed > 0)
+                {
+                    unsigned int writeIdx = 0;
+                    for(unsigned int readIdx = 0; readIdx < (unsigned int)entityIDs.size(); readIdx++)
+                    {
+                        const entityid_t entityID = entityIDs[readIdx];
+                        if(entitySlots[entityID] == CPagedSparseArray::NIL_INDEX)
+                        {
+                            continue;
+                        }
+
+                        if(writeIdx != readIdx)
+                        {
+                            entityIDs[writeIdx] = entityID;
+                            entitySlots.set(entityID, (int)writeIdx);
+                            updateInfo.moved++;
+                        }
+                        writeIdx++;
+                    }
+
+                    entityIDs.resize(writeIdx);
                 }
             }
         }
         
 
         // then addition
-        if(!m_pendingIn_setEntityIDs.empty() )
+        if(!m_vecPendingInEntityIDs.empty())
         {
-            m_targetQuery.m_vecEntityIDs.insert(
-                m_targetQuery.m_vecEntityIDs.end(),
-                m_pendingIn_setEntityIDs.begin(),
-                m_pendingIn_setEntityIDs.end()
-            );
+            // drop stale entries and entities that are already in the query
+            unsigned int addedCount = 0;
+            for(entityid_t entityID : m_vecPendingInEntityIDs)
+            {
+                if(isPendingIn(entityID))
+                {
+                    m_vecPendingInBits[entityID / 64] &= ~((uint64_t)1 << (entityID % 64));
+
+                    if(entitySlots[entityID] == CPagedSparseArray::NIL_INDEX)
+                    {
+                        m_vecPendingInEntityIDs[addedCount++] = entityID;
+                    }
+                }
+            }
+            m_vecPendingInEntityIDs.resize(addedCount);
+
+            // append in the order components lie in memory, so iterating over new entities doesn't jump around
+            if(m_orderTypeId != COMPONENT_TYPE_ID_INVALID)
+            {
+                const CComponentStorage *storage = m_targetQuery.m_storagePtr;
+                const componenttypeid_t orderTypeId = m_orderTypeId;
+
+                std::sort(m_vecPendingInEntityIDs.begin(), m_vecPendingInEntityIDs.end(), 
+                [storage, orderTypeId](entityid_t id1, entityid_t id2) {
+                    return storage->storageOrder(id1, orderTypeId) < storage->storageOrder(id2, orderTypeId);
+                });
+            }
 
-            updateInfo.added = (unsigned int)m_pendingIn_setEntityIDs.size();
+            for(entityid_t entityID : m_vecPendingInEntityIDs)
+            {
+                entitySlots.set(entityID, (int)entityIDs.size());
+                entityIDs.push_back(entityID);
+            }
+
+            updateInfo.added = addedCount;
         }
 
-        updateInfo.total = (unsigned int)m_targetQuery.m_vecEntityIDs.size();
+        m_targetQuery.m_isOutdated = m_hasBatchedChanges;
+
+        updateInfo.total = (unsigned int)entityIDs.size();
 
 
-        // clear pending data
-        m_pendingOut_setEntityIDs.clear();
-        m_pendingIn_setEntityIDs.clear();
+        // clear pending data, capacity stays for the next update
+        m_vecPendingOutEntityIDs.clear();
+        m_vecPendingInEntityIDs.clear();
 
 
         return updateInfo;
     }
 
+    inline void CEntityQueryGuard::markBatchedChanges()
+    {
+        m_hasBatchedChanges = true;
+        m_targetQuery.m_isOutdated = true;
+    }
+
+    inline void CEntityQueryGuard::clearBatchedChanges()
+    {
+        // query stays outdated until its next update
+        m_hasBatchedChanges = false;
+    }
+
+    inline bool CEntityQueryGuard::isPendingIn( entityid_t entityID ) const
+    {
+        const size_t word = entityID / 64;
+        return word < m_vecPendingInBits.size() && (m_vecPendingInBits[word] & ((uint64_t)1 << (entityID % 64)));
+    }
+
     inline bool CEntityQueryGuard::testQuery( const CEntitySignature& signature ) const
     {
         return signature.hasAllFrom(m_targetQuery.m_requireSignature) && !signature.hasAnyFrom(m_targetQuery.m_rejectSignature);
@@ -1,5 +1,3 @@
-#include <typelist.hpp>
-
 #include <tuple>
 
 namespace chestnut::ecs
@@ -9,10 +7,12 @@ namespace chestnut::ecs
     {
         CEntityQuery *m_query;
         unsigned int m_currentQueryIdx;
+        // resolved once on construction so dereferencing doesn't need to look them up; null with archetype storage
+        std::tuple<internal::CSparseSet<Types> *...> m_sparseSets;
 
 
         Iterator(CEntityQuery *query, unsigned int queryIdx) noexcept
-        : m_query(query), m_currentQueryIdx(queryIdx)
+        : m_query(query), m_currentQueryIdx(queryIdx), m_sparseSets(query->m_storagePtr->sparseSetPtr<Types>()...)
         {
             
         }
@@ -26,12 +26,9 @@ namespace chestnut::ecs
 
         std::tuple<Types&...> operator*()
         {
-            using TL = tl::type_list<Types...>;
+            const entityid_t id = m_query->m_vecEntityIDs[m_currentQueryIdx];
 
-            return TL::template for_each_and_collect<std::tuple>([&](auto t) -> typename decltype(t)::type& {
-                using T = typename decltype(t)::type;
-                return m_query->m_storagePtr->at<T>(m_query->m_vecEntityIDs[m_currentQueryIdx]);
-            });
+            return std::tuple<Types&...>(component<Types>(id)...);
         }
 
         Iterator& operator++() noexcept
@@ -83,6 +80,19 @@ namespace chestnut::ecs
         {
             return !(*this == other);
         }
+
+    private:
+        template<typename T>
+        T& component(entityid_t id) const
+        {
+            internal::CSparseSet<T> *sparseSet = std::get<internal::CSparseSet<T> *>(m_sparseSets);
+            if(sparseSet)
+            {
+                return sparseSet->at(id);
+            }
+
+            return m_query->m_storagePtr->at<T>(id);
+        }
     };
 
 } // namespace chestnut::ecs
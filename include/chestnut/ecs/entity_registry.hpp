@@ -1,9 +1,12 @@
 #pragma once
 
 #include "types.hpp"
+#include "entity_handle.hpp"
 #include "component_storage.hpp"
 #include "entity_signature.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <vector>
 
@@ -29,6 +32,24 @@ namespace chestnut::ecs::internal
          * @brief Vector of freed entity IDs 
          */
         std::vector< entityid_t > m_vecRecycledEntityIDs;
+        /**
+         * @brief Bitmap indexed by entity ID telling whether entity is currently registered
+         */
+        std::vector< bool > m_vecEntityAlive;
+        /**
+         * @brief Current version of each entity ID, incremented when entity gets unregistered
+         */
+        std::vector< entityversion_t > m_vecEntityVersions;
+
+        /**
+         * @brief Number of recycled IDs not yet taken by reserveEntity()
+         * 
+         * @details
+         * Reserving decrements it. While positive, it points one past the next recycled ID to take from the back of m_vecRecycledEntityIDs.
+         * Past zero it counts fresh IDs reserved after m_entityIdCounter.
+         * Equal to the size of m_vecRecycledEntityIDs when nothing is reserved.
+         */
+        std::atomic<int64_t> m_reserveCursor;
 
 
     public:
@@ -47,9 +68,35 @@ namespace chestnut::ecs::internal
          */
         entityid_t registerNewEntity(bool canRecycleId = true) noexcept;
 
+        // appends IDs of new entities to outIds
+        void registerNewEntities(entitysize_t count, std::vector<entityid_t>& outIds, bool canRecycleId = true) noexcept;
+
+        /**
+         * @brief Take an ID for an entity that will be registered by the next flushReservedEntities() call
+         * 
+         * @details
+         * Lock-free, can be called from many threads at once, but not concurrently with any other method.
+         * Takes recycled IDs first, in the same order registerNewEntity() would.
+         * 
+         * @return reserved entity ID
+         */
+        entityid_t reserveEntity() noexcept;
+
+        /**
+         * @brief Register all entities reserved with reserveEntity()
+         * 
+         * @details
+         * Called by all other methods that change the set of registered entities, so reserved IDs are never given out twice.
+         * 
+         * @return number of entities registered
+         */
+        entitysize_t flushReservedEntities() noexcept;
+
         /**
          * @brief Returns whether an entity with this id is registered
          * 
+         * @details Constant time, doesn't depend on the amount of recycled IDs
+         * 
          * @param id ID of the entity
          * 
          * @return true if entity record has been found
@@ -65,6 +112,28 @@ namespace chestnut::ecs::internal
         void unregisterEntity(entityid_t id) noexcept;
 
 
+        /**
+         * @brief Get the versioned handle of a registered entity
+         * 
+         * @param id ID of the entity
+         * 
+         * @return handle to the entity or ENTITY_HANDLE_INVALID if entity is not registered
+         */
+        SEntityHandle getEntityHandle(entityid_t id) const noexcept;
+
+        /**
+         * @brief Returns whether the handle still points to the entity it was created for
+         * 
+         * @details A single version comparison, stale handles to destroyed or recycled IDs are rejected
+         * 
+         * @param handle entity handle
+         * 
+         * @return true if entity the handle was made for is still registered
+         * @return false otherwise
+         */
+        bool isEntityHandleValid(SEntityHandle handle) const noexcept;
+
+
         
         /**
          * @brief Get the value of the internal ID counter
@@ -1,17 +1,19 @@
 #include "constants.hpp"
 
-#include <algorithm>
+#include <algorithm> // min
 
 namespace chestnut::ecs::internal
 {
     inline CEntityRegistry::CEntityRegistry(const CComponentStorage *componentStorage) noexcept
-    : m_componentStoragePtr(componentStorage), m_entityIdCounter(ENTITY_ID_MINIMAL)
+    : m_componentStoragePtr(componentStorage), m_entityIdCounter(ENTITY_ID_MINIMAL), m_reserveCursor(0)
     {
 
     }
 
     inline entityid_t CEntityRegistry::registerNewEntity(bool canRecycleId) noexcept
     {
+        flushReservedEntities();
+
         entityid_t id;
 
         if( canRecycleId && !m_vecRecycledEntityIDs.empty() )
@@ -24,38 +26,138 @@ namespace chestnut::ecs::internal
             id = m_entityIdCounter++;
         }
 
+        if(id >= m_vecEntityAlive.size())
+        {
+            m_vecEntityAlive.resize(id + 1, false);
+            m_vecEntityVersions.resize(id + 1, 0);
+        }
+        m_vecEntityAlive[id] = true;
+
+        m_reserveCursor.store((int64_t)m_vecRecycledEntityIDs.size(), std::memory_order_relaxed);
+
         return id;
     }
 
-    inline bool CEntityRegistry::isEntityRegistered(entityid_t id) const noexcept
+    inline void CEntityRegistry::registerNewEntities(entitysize_t count, std::vector<entityid_t>& outIds, bool canRecycleId) noexcept
+    {
+        flushReservedEntities();
+
+        outIds.reserve(outIds.size() + count);
+
+        entitysize_t recycledCount = 0;
+        if( canRecycleId )
+        {
+            recycledCount = std::min(count, (entitysize_t)m_vecRecycledEntityIDs.size());
+
+            // same order as if registerNewEntity was called repeatedly
+            outIds.insert(outIds.end(), m_vecRecycledEntityIDs.rbegin(), m_vecRecycledEntityIDs.rbegin() + recycledCount);
+            m_vecRecycledEntityIDs.resize(m_vecRecycledEntityIDs.size() - recycledCount);
+        }
+
+        for(entitysize_t i = recycledCount; i < count; i++)
+        {
+            outIds.push_back(m_entityIdCounter++);
+        }
+
+        if(m_entityIdCounter > m_vecEntityAlive.size())
+        {
+            m_vecEntityAlive.resize(m_entityIdCounter, false);
+            m_vecEntityVersions.resize(m_entityIdCounter, 0);
+        }
+
+        for(auto it = outIds.end() - count; it != outIds.end(); ++it)
+        {
+            m_vecEntityAlive[*it] = true;
+        }
+
+        m_reserveCursor.store((int64_t)m_vecRecycledEntityIDs.size(), std::memory_order_relaxed);
+    }
+
+    inline entityid_t CEntityRegistry::reserveEntity() noexcept
+    {
+        const int64_t cursor = m_reserveCursor.fetch_sub(1, std::memory_order_relaxed);
+
+        if(cursor > 0)
+        {
+            return m_vecRecycledEntityIDs[(size_t)cursor - 1];
+        }
+
+        return m_entityIdCounter + (entityid_t)(-cursor);
+    }
+
+    inline entitysize_t CEntityRegistry::flushReservedEntities() noexcept
     {
-        if( id == ENTITY_ID_INVALID )
+        const int64_t cursor = m_reserveCursor.load(std::memory_order_relaxed);
+        const int64_t recycledCount = (int64_t)m_vecRecycledEntityIDs.size();
+
+        if(cursor == recycledCount)
+        {
+            return 0;
+        }
+
+        // reserved recycled IDs are at the back of the vector
+        const size_t recycledKeptCount = cursor > 0 ? (size_t)cursor : 0;
+        for(size_t i = recycledKeptCount; i < m_vecRecycledEntityIDs.size(); i++)
         {
-            return false;
+            m_vecEntityAlive[m_vecRecycledEntityIDs[i]] = true;
         }
-        if(id < m_entityIdCounter)
+        m_vecRecycledEntityIDs.resize(recycledKeptCount);
+
+        if(cursor < 0)
         {
-            auto it = std::find_if(m_vecRecycledEntityIDs.begin(), m_vecRecycledEntityIDs.end(),
-                [id](entityid_t recycledId) {
-                    return id == recycledId;
-                }
-            );
+            const entityid_t freshBegin = m_entityIdCounter;
+            m_entityIdCounter += (entityid_t)(-cursor);
+
+            if(m_entityIdCounter > m_vecEntityAlive.size())
+            {
+                m_vecEntityAlive.resize(m_entityIdCounter, false);
+                m_vecEntityVersions.resize(m_entityIdCounter, 0);
+            }
 
-            if(it == m_vecRecycledEntityIDs.end())
+            for(entityid_t id = freshBegin; id < m_entityIdCounter; id++)
             {
-                return true;
+                m_vecEntityAlive[id] = true;
             }
         }
 
-        return false;
+        m_reserveCursor.store((int64_t)m_vecRecycledEntityIDs.size(), std::memory_order_relaxed);
+
+        return (entitysize_t)(recycledCount - cursor);
+    }
+
+    inline bool CEntityRegistry::isEntityRegistered(entityid_t id) const noexcept
+    {
+        return id < m_vecEntityAlive.size() && m_vecEntityAlive[id];
     }
 
     inline void CEntityRegistry::unregisterEntity(entityid_t id) noexcept
     {
+        flushReservedEntities();
+
         if(isEntityRegistered(id))
         {
+            m_vecEntityAlive[id] = false;
+            m_vecEntityVersions[id]++;
             m_vecRecycledEntityIDs.push_back(id);
+
+            m_reserveCursor.store((int64_t)m_vecRecycledEntityIDs.size(), std::memory_order_relaxed);
+        }
+    }
+
+    inline SEntityHandle CEntityRegistry::getEntityHandle(entityid_t id) const noexcept
+    {
+        if(isEntityRegistered(id))
+        {
+            return SEntityHandle{ id, m_vecEntityVersions[id] };
         }
+
+        return ENTITY_HANDLE_INVALID;
+    }
+
+    inline bool CEntityRegistry::isEntityHandleValid(SEntityHandle handle) const noexcept
+    {
+        // version is bumped on unregistering, so a handle to a dead entity never matches
+        return handle.id < m_vecEntityVersions.size() && m_vecEntityVersions[handle.id] == handle.version;
     }
 
     inline entityid_t CEntityRegistry::getHighestIdRegistered() const noexcept
@@ -12,24 +12,33 @@
 
 #pragma once
 
-#include <string>
+#include "types.hpp"
+#include "constants.hpp"
+
+#include <cstdint>
 #include <typeindex>
-#include <unordered_set>
 
 namespace chestnut::ecs
 {
-    //TODO implement iterator
     /**
      * @brief Class used to record component types that entity is comprised of
+     * 
+     * @details
+     * Signature is a fixed-width bitset over component type IDs (see internal::CComponentTypeFamily),
+     * so it never allocates and set operations on it boil down to a few word-wide bitwise operations.
      */
     class CEntitySignature
     {
-    public:
-        //TODO replace with std::vector and use binary search
+    private:
+        static const componenttypeid_t WORD_COUNT = MAX_COMPONENT_TYPES / 64;
+
         /**
-         * @brief Set of std::type_index component types
+         * @brief Bits of component type IDs present in the signature
          */
-        std::unordered_set< std::type_index > m_setComponentTypes;
+        uint64_t m_bits[WORD_COUNT] = {};
+
+        friend bool operator==( const CEntitySignature& lhs, const CEntitySignature& rhs );
+        friend CEntitySignature operator^( const CEntitySignature& lhs, const CEntitySignature& rhs );
 
     public:
         /**
@@ -95,6 +104,40 @@ namespace chestnut::ecs
          */
         bool has( std::type_index compType ) const;
 
+
+        /**
+         * @brief Adds type to signature using its component type ID
+         * 
+         * @param typeId ID of the component type
+         * 
+         * @throws std::out_of_range if ID doesn't fit into MAX_COMPONENT_TYPES
+         */
+        void add( componenttypeid_t typeId );
+
+        /**
+         * @brief Removes type from signature using its component type ID
+         * 
+         * @param typeId ID of the component type
+         */
+        void remove( componenttypeid_t typeId );
+
+        /**
+         * @brief Checks if type with given component type ID is in signature
+         * 
+         * @param typeId ID of the component type
+         * @return true if type is in signature
+         * @return false otherwise
+         */
+        bool has( componenttypeid_t typeId ) const;
+
+        /**
+         * @brief Calls the function for ID of every component type in signature in ascending order
+         * 
+         * @param func function taking componenttypeid_t
+         */
+        template< typename F >
+        void forEachType( F&& func ) const;
+
         
         /**
          * @brief Adds types from other signature
@@ -206,6 +249,15 @@ namespace chestnut::ecs
 	 */
 	bool operator!=( const CEntitySignature& lhs, const CEntitySignature& rhs );
 
+	/**
+	 * @brief Returns types that are present in exactly one of the signatures
+	 * 
+	 * @param lhs left-hand-side signature
+	 * @param rhs right-hand-side signature
+	 * @return CEntitySignature symmetric difference of signatures
+	 */
+	CEntitySignature operator^( const CEntitySignature& lhs, const CEntitySignature& rhs );
+
 
     //TODO remove in 2.0
 	/**
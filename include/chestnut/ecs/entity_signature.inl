@@ -1,8 +1,57 @@
 #include <typelist.hpp>
 #include "entity_signature.hpp"
+#include "component_type_family.hpp"
+
+#include <stdexcept>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
 
 namespace chestnut::ecs
-{    
+{
+    namespace internal
+    {
+        inline int countBits( uint64_t word )
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_popcountll( word );
+#elif defined(_MSC_VER)
+            return (int)__popcnt64( word );
+#else
+            int count = 0;
+            while( word )
+            {
+                word &= word - 1;
+                count++;
+            }
+            return count;
+#endif
+        }
+
+        inline componenttypeid_t lowestBitIndex( uint64_t word )
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return (componenttypeid_t)__builtin_ctzll( word );
+#elif defined(_MSC_VER)
+            unsigned long idx;
+            _BitScanForward64( &idx, word );
+            return (componenttypeid_t)idx;
+#else
+            componenttypeid_t idx = 0;
+            while( !( word & 1 ) )
+            {
+                word >>= 1;
+                idx++;
+            }
+            return idx;
+#endif
+        }
+
+    } // namespace internal
+
+
+
     template <typename... Types>
     inline CEntitySignature CEntitySignature::from()
     {
@@ -13,85 +62,131 @@ namespace chestnut::ecs
 
     inline void CEntitySignature::add( std::type_index compType ) 
     {
-        m_setComponentTypes.insert( compType );
+        add( internal::CComponentTypeFamily::id( compType ) );
     }
 
     inline void CEntitySignature::remove( std::type_index compType ) 
     {
-        m_setComponentTypes.erase( compType );
+        remove( internal::CComponentTypeFamily::find( compType ) );
     }
 
     inline bool CEntitySignature::has( std::type_index compType ) const
     {
-        auto it = m_setComponentTypes.find( compType );
-        if( it != m_setComponentTypes.end() )
+        return has( internal::CComponentTypeFamily::find( compType ) );
+    }
+
+    inline void CEntitySignature::add( componenttypeid_t typeId ) 
+    {
+        if( typeId >= MAX_COMPONENT_TYPES )
+        {
+            throw std::out_of_range( "Component type ID exceeds MAX_COMPONENT_TYPES" );
+        }
+
+        m_bits[ typeId / 64 ] |= uint64_t(1) << ( typeId % 64 );
+    }
+
+    inline void CEntitySignature::remove( componenttypeid_t typeId ) 
+    {
+        if( typeId < MAX_COMPONENT_TYPES )
         {
-            return true;
+            m_bits[ typeId / 64 ] &= ~( uint64_t(1) << ( typeId % 64 ) );
         }
-        else
+    }
+
+    inline bool CEntitySignature::has( componenttypeid_t typeId ) const
+    {
+        if( typeId >= MAX_COMPONENT_TYPES )
         {
             return false;
         }
+
+        return ( m_bits[ typeId / 64 ] >> ( typeId % 64 ) ) & 1;
+    }
+
+    template< typename F >
+    inline void CEntitySignature::forEachType( F&& func ) const
+    {
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
+        {
+            uint64_t word = m_bits[w];
+            while( word )
+            {
+                func( (componenttypeid_t)( w * 64 + internal::lowestBitIndex( word ) ) );
+                word &= word - 1;
+            }
+        }
     }
 
     inline void CEntitySignature::addFrom( const CEntitySignature& otherSign ) 
     {
-        for( std::type_index type : otherSign.m_setComponentTypes )
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
         {
-            m_setComponentTypes.insert( type );
+            m_bits[w] |= otherSign.m_bits[w];
         }
     }
 
     inline void CEntitySignature::removeFrom( const CEntitySignature& otherSign ) 
     {
-        for( std::type_index type : otherSign.m_setComponentTypes )
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
         {
-            m_setComponentTypes.erase( type );
+            m_bits[w] &= ~otherSign.m_bits[w];
         }
     }
 
     inline bool CEntitySignature::hasAllFrom( const CEntitySignature& otherSign ) const
     {
-        bool areAllPresent = true;
+        uint64_t missing = 0;
 
-        for( std::type_index type : otherSign.m_setComponentTypes )
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
         {
-            if( !has( type ) )
-            {
-                areAllPresent = false;
-                break;
-            }
+            missing |= otherSign.m_bits[w] & ~m_bits[w];
         }
 
-        return areAllPresent;
+        return missing == 0;
     }
 
     inline bool CEntitySignature::hasAnyFrom( const CEntitySignature& otherSign ) const
     {
-        for( std::type_index type : otherSign.m_setComponentTypes )
+        uint64_t common = 0;
+
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
         {
-            if( has( type ) )
-            {
-                return true;
-            }
+            common |= otherSign.m_bits[w] & m_bits[w];
         }
 
-        return false;
+        return common != 0;
     }
 
     inline void CEntitySignature::clear() 
     {
-        m_setComponentTypes.clear();
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
+        {
+            m_bits[w] = 0;
+        }
     }
 
     inline bool CEntitySignature::isEmpty() const
     {
-        return m_setComponentTypes.empty();
+        uint64_t any = 0;
+
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
+        {
+            any |= m_bits[w];
+        }
+
+        return any == 0;
     }
 
     inline int CEntitySignature::getSize() const
     {
-        return (int)m_setComponentTypes.size();
+        int size = 0;
+
+        for( componenttypeid_t w = 0; w < WORD_COUNT; w++ )
+        {
+            size += internal::countBits( m_bits[w] );
+        }
+
+        return size;
     }
 
     inline CEntitySignature& CEntitySignature::operator+=( const CEntitySignature& other ) 
@@ -122,12 +217,31 @@ namespace chestnut::ecs
 
     inline bool operator==( const CEntitySignature& lhs, const CEntitySignature& rhs )
     {
-        return lhs.m_setComponentTypes == rhs.m_setComponentTypes;
+        uint64_t diff = 0;
+
+        for( componenttypeid_t w = 0; w < CEntitySignature::WORD_COUNT; w++ )
+        {
+            diff |= lhs.m_bits[w] ^ rhs.m_bits[w];
+        }
+
+        return diff == 0;
     }
 
     inline bool operator!=( const CEntitySignature& lhs, const CEntitySignature& rhs )
     {
-        return lhs.m_setComponentTypes != rhs.m_setComponentTypes;
+        return !( lhs == rhs );
+    }
+
+    inline CEntitySignature operator^( const CEntitySignature& lhs, const CEntitySignature& rhs )
+    {
+        CEntitySignature newSign;
+
+        for( componenttypeid_t w = 0; w < CEntitySignature::WORD_COUNT; w++ )
+        {
+            newSign.m_bits[w] = lhs.m_bits[w] ^ rhs.m_bits[w];
+        }
+
+        return newSign;
     }
 
     template <typename... Types>
@@ -136,7 +250,7 @@ namespace chestnut::ecs
         using list = tl::type_list<Types...>;
         list::for_each( [&](auto t)
         {
-            add( typeid( typename decltype(t)::type ) );
+            add( internal::CComponentTypeFamily::id<typename decltype(t)::type>() );
         });
     }
 
@@ -146,7 +260,7 @@ namespace chestnut::ecs
         using list = tl::type_list<Types...>;
         list::for_each( [&](auto t)
         {
-            remove( typeid( typename decltype(t)::type ) );
+            remove( internal::CComponentTypeFamily::id<typename decltype(t)::type>() );
         });
     }
 
@@ -158,7 +272,7 @@ namespace chestnut::ecs
         using list = tl::type_list<Types...>;
         list::for_each( [&](auto t)
         {
-            _has = _has && has( typeid( typename decltype(t)::type ) );
+            _has = _has && has( internal::CComponentTypeFamily::id<typename decltype(t)::type>() );
         });
 
         return _has;
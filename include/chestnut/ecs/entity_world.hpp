@@ -13,6 +13,7 @@
 #pragma once
 
 #include "types.hpp"
+#include "entity_handle.hpp"
 #include "component_storage.hpp"
 #include "entity_registry.hpp"
 #include "entity_query_guard.hpp"
@@ -50,7 +51,69 @@ namespace chestnut::ecs
          */
         mutable std::unordered_map<CEntityQuery *, std::unique_ptr<internal::CEntityQueryGuard>> m_mapQueryIDToQueryGuard;
 
-        //TODO unused mutex, do something about it
+        /**
+         * @brief Guards of queries that mention given component type in their require or reject signature, indexed by component type ID
+         * 
+         * @details
+         * When an entity's signature changes, only queries that mention at least one of the changed types can change their verdict,
+         * so only those get tested.
+         */
+        std::vector<std::vector<internal::CEntityQueryGuard *>> m_vecTypeIdToQueryGuards;
+
+        /**
+         * @brief Guards of queries with empty require signature; they can accept entities with none of the types they mention
+         */
+        std::vector<internal::CEntityQueryGuard *> m_vecUnconstrainedQueryGuards;
+
+        /**
+         * @brief Scratch buffer for guards to test on entity change, kept to avoid allocations
+         */
+        std::vector<internal::CEntityQueryGuard *> m_vecQueryGuardsToUpdate;
+
+        /**
+         * @brief Entity as it was before its first change in the currently open batch
+         */
+        struct SBatchedEntity
+        {
+            entityid_t id;
+            CEntitySignature startSignature;
+            // false if the entity was created with components during the batch
+            bool hadSignature;
+            // set if the entity was destroyed during the batch, its ID may have been given to a new entity since
+            bool wasDestroyed;
+            // set if a new entity with that ID got changed after the destruction
+            bool changedAfterDestroy;
+            // like hadSignature, but for the new entity
+            bool hadSignatureAfterDestroy;
+        };
+
+        /**
+         * @brief How many times beginBatch() was called without matching endBatch()
+         */
+        unsigned int m_batchDepth;
+
+        /**
+         * @brief Entities changed during the open batch, each recorded once
+         */
+        std::vector<SBatchedEntity> m_vecBatchedEntities;
+
+        /**
+         * @brief Index of each entity in m_vecBatchedEntities
+         */
+        internal::CPagedSparseArray m_batchedEntitySlots;
+
+        /**
+         * @brief Entities that share the same signature, passed to queries together by bulk operations
+         */
+        struct SEntityGroup
+        {
+            CEntitySignature signature;
+            std::vector<entityid_t> entities;
+            // signature entities end up with, when grouped entities may go through different changes
+            CEntitySignature nextSignature;
+        };
+
+                //TODO unused mutex, do something about it
         /**
          * @brief Shared mutex that can be used for synchronizing actions on the world between threads
          */
@@ -61,8 +124,11 @@ namespace chestnut::ecs
     public:
         /**
          * @brief Constructor
+         * 
+         * @param storageBackend layout of component storage; 
+         * ARCHETYPE speeds up queries joining many component types at the cost of slower adding and removing of components
          */
-        CEntityWorld();
+        CEntityWorld(EComponentStorageBackend storageBackend = EComponentStorageBackend::SPARSE_SET);
 
         // World is too heavy to have it be able to be copied
         CEntityWorld(const CEntityWorld&) = delete;
@@ -99,6 +165,48 @@ namespace chestnut::ecs
         template<typename C, typename... CRest>
         entityid_t createEntityWithComponents(std::tuple<C, CRest...>&& data, bool canRecycleId = true);
 
+        /**
+         * @brief Create many new entities at once
+         * 
+         * @param count number of entities to create
+         * @param outIds vector IDs of new entities get appended to
+         * @param canRecycleId if IDs can be reused from previously destroyed entities
+         */
+        void createEntities(entitysize_t count, std::vector<entityid_t>& outIds, bool canRecycleId = true);
+
+        /**
+         * @brief Create many new entities with the same set of components at once
+         * 
+         * @details
+         * Storage is reserved once for all components and every query gets all matching entities in a single append.
+         * 
+         * @tparam Cs types of components
+         * @param count number of entities to create
+         * @param generator callable taking the index of entity in [0, count) and returning std::tuple<Cs...> or an rvalue reference to one
+         * (or just the component if there's only one type)
+         * @param canRecycleId if IDs can be reused from previously destroyed entities
+         * @return IDs of new entities, in the order they were passed to the generator
+         */
+        template<typename... Cs, typename F>
+        std::vector<entityid_t> createEntitiesWithComponents(entitysize_t count, F&& generator, bool canRecycleId = true);
+
+        /**
+         * @brief Reserve an ID for an entity that will be created on the next flushReservedEntities() call
+         * 
+         * @details
+         * Lock-free, can be called from many threads at once, but not concurrently with any other method of the world.
+         * Until the flush, entity with that ID doesn't exist yet.
+         * Flush happens on its own with any other call that creates or destroys entities.
+         * 
+         * @return reserved entity ID
+         */
+        entityid_t reserveEntity();
+
+        /**
+         * @brief Create empty entities for all IDs given by reserveEntity()
+         */
+        void flushReservedEntities();
+
         /**
          * @brief Checks if entity with that ID exists
          * 
@@ -115,6 +223,55 @@ namespace chestnut::ecs
          */
         void destroyEntity(entityid_t entityID);
 
+        /**
+         * @brief Erase many entities and all components that belong to them
+         * 
+         * @details
+         * Components are erased pool by pool and each query is updated once per distinct signature of destroyed entities.
+         * IDs of entities that don't exist are skipped.
+         * 
+         * @param entityIDs IDs of the entities
+         */
+        void destroyEntities(const std::vector<entityid_t>& entityIDs);
+
+        /**
+         * @brief Erase all entities that currently match the query
+         * 
+         * @details
+         * The query is updated first, so entities that started matching it since its last update are destroyed too.
+         * 
+         * @param query query of entities to destroy
+         * 
+         * @throws QueryException if query is invalid
+         */
+        void destroyEntities(CEntityQuery *query);
+
+
+        /**
+         * @brief Get a versioned handle to the entity, that will stop being valid once the entity is destroyed,
+         * even if its ID gets recycled
+         * 
+         * @param entityID ID of the entity
+         * @return entity handle or ENTITY_HANDLE_INVALID if entity doesn't exist
+         */
+        SEntityHandle getEntityHandle(entityid_t entityID) const;
+
+        /**
+         * @brief Checks if entity the handle was made for still exists
+         * 
+         * @param handle entity handle
+         * @return true if entity exists
+         * @return false if it was destroyed, even if its ID has been recycled since
+         */
+        bool hasEntity(SEntityHandle handle) const;
+
+        /**
+         * @brief Erase entity and all components that belong to it, does nothing if handle is stale
+         * 
+         * @param handle entity handle
+         */
+        void destroyEntity(SEntityHandle handle);
+
 
 
 
@@ -128,21 +285,84 @@ namespace chestnut::ecs
         template<typename C>
         CComponentHandle<C> createOrUpdateComponent(entityid_t entityId, C &&data);
 
+        // Bulk version of createComponent; i-th component goes to i-th entity
+        // Entities that don't exist or already own the component are skipped
+        // Returns the number of components created
+        template<typename C>
+        entitysize_t createComponents(const std::vector<entityid_t>& entityIDs, std::vector<C>&& data);
+
+        // Same as above, but i-th component is moved from the object data[i] points to
+        // Lets components constructed elsewhere go straight into the storage
+        template<typename C>
+        entitysize_t createComponents(const std::vector<entityid_t>& entityIDs, C *const *data);
+
+        // Creates many components for one entity as a single change, so queries get updated only once
+        // Components the entity already owns are left as they were
+        // Returns false if entity doesn't exist
+        template<typename C, typename... CRest>
+        bool createComponents(entityid_t entityID, C&& data, CRest&&... dataRest);
+
         template<typename C>
         bool hasComponent(entityid_t entityID) const;
 
+        // Returns false if handle is stale
+        template<typename C>
+        bool hasComponent(SEntityHandle handle) const;
+
         // Returns null if entity doesn't exist or if it doesn't own that component
         // Otherwise returns component owned by the entity
         template<typename C>
         CComponentHandle<C> getComponent(entityid_t entityID) const;
 
+        // Returns null if handle is stale or if entity doesn't own that component
+        template<typename C>
+        CComponentHandle<C> getComponent(SEntityHandle handle) const;
+
         template<typename C>
         void destroyComponent(entityid_t entityID);
 
+        // Destroys many components of the entity as a single change, so queries get updated only once
+        template<typename C, typename... CRest>
+        void destroyComponents(entityid_t entityID);
+
         
 
 
-        CEntityQuery *createQuery(const CEntitySignature& requireSignature, const CEntitySignature& rejectSignature);
+        /**
+         * @brief Starts batching structural changes
+         * 
+         * @details
+         * Until the matching endBatch() call, creating and destroying entities and components 
+         * only marks entities as changed. Queries learn about these changes all at once when the batch ends,
+         * with every entity compared only against its signature from before the batch.
+         * Batches can be nested; queries are updated when the outermost one ends.
+         */
+        void beginBatch();
+
+        /**
+         * @brief Ends batch started with beginBatch() and passes collected entity changes to queries
+         */
+        void endBatch();
+
+        /**
+         * @brief RAII wrapper for beginBatch() and endBatch()
+         */
+        class BatchScope
+        {
+        private:
+            CEntityWorld& m_world;
+
+        public:
+            BatchScope(CEntityWorld& world) : m_world(world) { m_world.beginBatch(); }
+            BatchScope(const BatchScope&) = delete;
+            BatchScope& operator=(const BatchScope&) = delete;
+            ~BatchScope() { m_world.endBatch(); }
+        };
+
+
+
+
+                CEntityQuery *createQuery(const CEntitySignature& requireSignature, const CEntitySignature& rejectSignature);
         CEntityQuery *createQuery(const CEntitySignature& requireSignature);
 
         // Returns info on how the query got updated
@@ -177,7 +397,30 @@ namespace chestnut::ecs
 
     private:
         // If null passed for signature, it is interpreted as that the signature is definitely empty
+        // If a batch is open, only records the change
         void updateQueriesOnEntityChange(entityid_t entity, const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
+
+        // Same as updateQueriesOnEntityChange, but for many entities that went through the same change
+        void updateQueriesOnEntitiesChange(const std::vector<entityid_t>& entities, const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
+
+        // Common part of bulk createComponents overloads, dataAt(i) gives rvalue of the i-th component
+        template<typename C, typename F>
+        entitysize_t createComponentsFrom(const std::vector<entityid_t>& entityIDs, entitysize_t count, F&& dataAt);
+
+        // Puts entity into the group of entities with the same signature (and next signature), creating one if necessary
+        static void addToEntityGroup(std::vector<SEntityGroup>& groups, const CEntitySignature& signature, entityid_t entity, const CEntitySignature& nextSignature = CEntitySignature());
+
+        // Fills m_vecQueryGuardsToUpdate with guards of queries that can change their verdict on the entity, may contain duplicates
+        void gatherQueryGuardsOnEntityChange(const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
+
+        // Records entity in the open batch, if it hasn't been yet, and notes if it's been destroyed or its ID reused
+        void recordBatchedEntityChange(entityid_t entity, const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
+
+        // Keeps queries affected by a change made in the open batch from walking archetype tables directly until the batch ends
+        void markQueriesOnBatchedChange(const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
+
+        // Tests each affected query once for all entities
+        void testQueriesOnEntityChange(const entityid_t *entities, entitysize_t entityCount, const CEntitySignature* prevSignature, const CEntitySignature* currSignature);
     };
 
 } // namespace chestnut::ecs
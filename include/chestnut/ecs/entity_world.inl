@@ -2,10 +2,15 @@
 
 #include <typelist.hpp>
 
+#include <algorithm> // find_if, min, remove, sort, unique
+#include <type_traits> // is_same_v, decay_t
+
 namespace chestnut::ecs
 {
-    inline CEntityWorld::CEntityWorld() 
-    : m_entityRegistry(&m_componentStorage),
+    inline CEntityWorld::CEntityWorld(EComponentStorageBackend storageBackend) 
+    : m_componentStorage(storageBackend),
+      m_entityRegistry(&m_componentStorage),
+      m_batchDepth(0),
       entityIterator(this)
     {
         
@@ -52,6 +57,53 @@ namespace chestnut::ecs
         return ent;
     }
 
+    inline entityid_t CEntityWorld::reserveEntity()
+    {
+        return m_entityRegistry.reserveEntity();
+    }
+
+    inline void CEntityWorld::flushReservedEntities()
+    {
+        // empty entities don't belong to any query, same as with createEntity()
+        m_entityRegistry.flushReservedEntities();
+    }
+
+    inline void CEntityWorld::createEntities(entitysize_t count, std::vector<entityid_t>& outIds, bool canRecycleId)
+    {
+        m_entityRegistry.registerNewEntities(count, outIds, canRecycleId);
+    }
+
+    template<typename... Cs, typename F>
+    std::vector<entityid_t> CEntityWorld::createEntitiesWithComponents(entitysize_t count, F&& generator, bool canRecycleId)
+    {
+        static_assert(sizeof...(Cs) > 0, "At least one component type must be given");
+
+        std::vector<entityid_t> ents;
+        m_entityRegistry.registerNewEntities(count, ents, canRecycleId);
+
+        (m_componentStorage.reserve<Cs>(count), ...);
+
+        for(entitysize_t i = 0; i < count; i++)
+        {
+            if constexpr(std::is_same_v<std::decay_t<decltype(generator(i))>, std::tuple<Cs...>>)
+            {
+                // generator may return a reference to tuple it keeps, which saves moving it here
+                auto&& data = generator(i);
+                (m_componentStorage.insert<Cs>(ents[i], std::move(std::get<Cs>(data))), ...);
+            }
+            else
+            {
+                static_assert(sizeof...(Cs) == 1, "Generator must return std::tuple of all component types");
+                (m_componentStorage.insert<Cs>(ents[i], Cs(generator(i))), ...);
+            }
+        }
+
+        CEntitySignature newSign = CEntitySignature::from<Cs...>();
+        this->updateQueriesOnEntitiesChange(ents, nullptr, &newSign);
+
+        return ents;
+    }
+
     inline bool CEntityWorld::hasEntity( entityid_t entityID ) const
     {
         return m_entityRegistry.isEntityRegistered(entityID);
@@ -73,6 +125,62 @@ namespace chestnut::ecs
         }
     }
 
+    inline void CEntityWorld::destroyEntities(const std::vector<entityid_t>& entityIDs)
+    {
+        std::vector<SEntityGroup> groups;
+        std::vector<entityid_t> entitiesWithComponents;
+
+        for(entityid_t entityID : entityIDs)
+        {
+            // also filters out duplicates, as entity is unregistered right away
+            if(!hasEntity(entityID))
+            {
+                continue;
+            }
+
+            const CEntitySignature signature = m_entityRegistry.getEntitySignature(entityID);
+            if(!signature.isEmpty())
+            {
+                addToEntityGroup(groups, signature, entityID);
+                entitiesWithComponents.push_back(entityID);
+            }
+
+            m_entityRegistry.unregisterEntity(entityID);
+        }
+
+        for(const SEntityGroup& group : groups)
+        {
+            updateQueriesOnEntitiesChange(group.entities, &group.signature, nullptr);
+        }
+
+        m_componentStorage.eraseAll(entitiesWithComponents.data(), (entitysize_t)entitiesWithComponents.size());
+    }
+
+    inline void CEntityWorld::destroyEntities(CEntityQuery *query)
+    {
+        queryEntities(query);
+
+        destroyEntities(query->getEntities());
+    }
+
+    inline SEntityHandle CEntityWorld::getEntityHandle( entityid_t entityID ) const
+    {
+        return m_entityRegistry.getEntityHandle(entityID);
+    }
+
+    inline bool CEntityWorld::hasEntity( SEntityHandle handle ) const
+    {
+        return m_entityRegistry.isEntityHandleValid(handle);
+    }
+
+    inline void CEntityWorld::destroyEntity( SEntityHandle handle ) 
+    {
+        if(hasEntity(handle))
+        {
+            destroyEntity(handle.id);
+        }
+    }
+
 
 
 
@@ -127,6 +235,91 @@ namespace chestnut::ecs
         return CComponentHandle<C>(entityID, &m_componentStorage);
     }
     
+    template<typename C>
+    inline entitysize_t CEntityWorld::createComponents(const std::vector<entityid_t>& entityIDs, std::vector<C>&& data)
+    {
+        const entitysize_t count = (entitysize_t)std::min(entityIDs.size(), data.size());
+
+        return createComponentsFrom<C>(entityIDs, count, [&data](entitysize_t i) -> C&& {
+            return std::move(data[i]);
+        });
+    }
+
+    template<typename C>
+    inline entitysize_t CEntityWorld::createComponents(const std::vector<entityid_t>& entityIDs, C *const *data)
+    {
+        return createComponentsFrom<C>(entityIDs, (entitysize_t)entityIDs.size(), [data](entitysize_t i) -> C&& {
+            return std::move(*data[i]);
+        });
+    }
+
+    template<typename C, typename F>
+    inline entitysize_t CEntityWorld::createComponentsFrom(const std::vector<entityid_t>& entityIDs, entitysize_t count, F&& dataAt)
+    {
+        // entities that had the same signature before go through the same change, so they're passed to queries together
+        std::vector<SEntityGroup> groups;
+
+        m_componentStorage.reserve<C>(count);
+
+        entitysize_t created = 0;
+        for(entitysize_t i = 0; i < count; i++)
+        {
+            const entityid_t entityID = entityIDs[i];
+            if(!hasEntity(entityID) || m_componentStorage.contains<C>(entityID))
+            {
+                continue;
+            }
+
+            const CEntitySignature prevSignature = m_entityRegistry.getEntitySignature(entityID);
+            m_componentStorage.insert<C>(entityID, dataAt(i));
+            created++;
+
+            addToEntityGroup(groups, prevSignature, entityID);
+        }
+
+        for(const SEntityGroup& group : groups)
+        {
+            CEntitySignature newSignature = group.signature;
+            newSignature.add<C>();
+
+            updateQueriesOnEntitiesChange(group.entities, &group.signature, &newSignature);
+        }
+
+        return created;
+    }
+    
+    template<typename C, typename... CRest>
+    inline bool CEntityWorld::createComponents(entityid_t entityID, C&& data, CRest&&... dataRest)
+    {
+        if(!hasEntity(entityID))
+        {
+            return false;
+        }
+
+        const CEntitySignature oldSignature = m_entityRegistry.getEntitySignature(entityID);
+        CEntitySignature newSignature = oldSignature;
+
+        auto createOne = [this, entityID, &newSignature](auto&& component) {
+            using T = std::decay_t<decltype(component)>;
+
+            if(!newSignature.has<T>())
+            {
+                m_componentStorage.insert<T>(entityID, T(std::forward<decltype(component)>(component)));
+                newSignature.add<T>();
+            }
+        };
+
+        createOne(std::forward<C>(data));
+        (createOne(std::forward<CRest>(dataRest)), ...);
+
+        if(newSignature != oldSignature)
+        {
+            updateQueriesOnEntityChange(entityID, &oldSignature, &newSignature);
+        }
+
+        return true;
+    }
+    
     template < typename C >
     bool CEntityWorld::hasComponent( entityid_t entityID ) const
     {
@@ -138,6 +331,12 @@ namespace chestnut::ecs
         return m_componentStorage.contains<C>(entityID);
     }
 
+    template < typename C >
+    bool CEntityWorld::hasComponent( SEntityHandle handle ) const
+    {
+        return hasEntity(handle) && m_componentStorage.contains<C>(handle.id);
+    }
+
     template< typename C >
     CComponentHandle<C> CEntityWorld::getComponent( entityid_t entityID ) const
     {
@@ -149,6 +348,17 @@ namespace chestnut::ecs
         return CComponentHandle<C>();
     }
 
+    template< typename C >
+    CComponentHandle<C> CEntityWorld::getComponent( SEntityHandle handle ) const
+    {
+        if(hasComponent<C>(handle))
+        {
+            return CComponentHandle<C>(handle.id, &m_componentStorage);
+        }
+
+        return CComponentHandle<C>();
+    }
+
     template< typename C >
     void CEntityWorld::destroyComponent( entityid_t entityID ) 
     {
@@ -166,6 +376,121 @@ namespace chestnut::ecs
         }
     }
 
+    template<typename C, typename... CRest>
+    void CEntityWorld::destroyComponents( entityid_t entityID )
+    {
+        if(!hasEntity(entityID))
+        {
+            return;
+        }
+
+        const CEntitySignature oldSignature = m_entityRegistry.getEntitySignature( entityID );
+
+        CEntitySignature newSignature = oldSignature;
+        newSignature.remove<C, CRest...>();
+
+        if(newSignature != oldSignature)
+        {
+            m_componentStorage.erase<C>(entityID);
+            (m_componentStorage.erase<CRest>(entityID), ...);
+
+            updateQueriesOnEntityChange( entityID, &oldSignature, &newSignature );
+        }
+    }
+
+
+
+
+
+    inline void CEntityWorld::beginBatch()
+    {
+        m_batchDepth++;
+    }
+
+    inline void CEntityWorld::endBatch()
+    {
+        if(m_batchDepth == 0 || --m_batchDepth > 0)
+        {
+            return;
+        }
+
+        if(!m_vecBatchedEntities.empty())
+        {
+            for(auto& [query, guard] : m_mapQueryIDToQueryGuard)
+            {
+                guard->clearBatchedChanges();
+            }
+        }
+
+        // entities that went through the same change are passed to queries together
+        std::vector<SEntityGroup> createdGroups;
+        std::vector<SEntityGroup> destroyedGroups;
+        std::vector<SEntityGroup> changedGroups;
+
+        for(const SBatchedEntity& batched : m_vecBatchedEntities)
+        {
+            const bool isAlive = hasEntity(batched.id);
+
+            if(isAlive && batched.wasDestroyed)
+            {
+                // ID was given to a new entity, for queries it's a different one than the destroyed entity
+                if(batched.hadSignature)
+                {
+                    addToEntityGroup(destroyedGroups, batched.startSignature, batched.id);
+                }
+
+                // new entity without any changes is empty, queries haven't been told about it
+                if(batched.changedAfterDestroy)
+                {
+                    const CEntitySignature currSignature = m_entityRegistry.getEntitySignature(batched.id);
+                    if(!batched.hadSignatureAfterDestroy)
+                    {
+                        addToEntityGroup(createdGroups, currSignature, batched.id);
+                    }
+                    else if(!currSignature.isEmpty())
+                    {
+                        addToEntityGroup(changedGroups, CEntitySignature(), batched.id, currSignature);
+                    }
+                }
+            }
+            else if(!batched.hadSignature)
+            {
+                // entities both created and destroyed during the batch were never seen by queries
+                if(isAlive)
+                {
+                    addToEntityGroup(createdGroups, m_entityRegistry.getEntitySignature(batched.id), batched.id);
+                }
+            }
+            else if(!isAlive)
+            {
+                addToEntityGroup(destroyedGroups, batched.startSignature, batched.id);
+            }
+            else
+            {
+                const CEntitySignature currSignature = m_entityRegistry.getEntitySignature(batched.id);
+                if(currSignature != batched.startSignature)
+                {
+                    addToEntityGroup(changedGroups, batched.startSignature, batched.id, currSignature);
+                }
+            }
+        }
+
+        m_vecBatchedEntities.clear();
+        m_batchedEntitySlots.reset();
+
+        for(const SEntityGroup& group : destroyedGroups)
+        {
+            testQueriesOnEntityChange(group.entities.data(), (entitysize_t)group.entities.size(), &group.signature, nullptr);
+        }
+        for(const SEntityGroup& group : changedGroups)
+        {
+            testQueriesOnEntityChange(group.entities.data(), (entitysize_t)group.entities.size(), &group.signature, &group.nextSignature);
+        }
+        for(const SEntityGroup& group : createdGroups)
+        {
+            testQueriesOnEntityChange(group.entities.data(), (entitysize_t)group.entities.size(), nullptr, &group.signature);
+        }
+    }
 
 
 
@@ -186,6 +511,20 @@ namespace chestnut::ecs
             guard->enqueueEntity(vecEntitiesToFetchFrom[i]);
         }
     
+        if(requireSignature.isEmpty())
+        {
+            m_vecUnconstrainedQueryGuards.push_back(guard.get());
+        }
+
+        (requireSignature + rejectSignature).forEachType([this, &guard](componenttypeid_t typeId) {
+            if(typeId >= m_vecTypeIdToQueryGuards.size())
+            {
+                m_vecTypeIdToQueryGuards.resize(typeId + 1);
+            }
+
+            m_vecTypeIdToQueryGuards[typeId].push_back(guard.get());
+        });
+
         CEntityQuery *query = &guard->getQuery();
         m_mapQueryIDToQueryGuard[query] = std::move(guard);
 
@@ -218,6 +557,17 @@ namespace chestnut::ecs
         auto it = m_mapQueryIDToQueryGuard.find( query );
         if( it != m_mapQueryIDToQueryGuard.end() )
         {
+            internal::CEntityQueryGuard *guard = it->second.get();
+            auto eraseGuard = [guard](std::vector<internal::CEntityQueryGuard *>& guards) {
+                guards.erase(std::remove(guards.begin(), guards.end(), guard), guards.end());
+            };
+
+            eraseGuard(m_vecUnconstrainedQueryGuards);
+
+            (query->getRequireSignature() + query->getRejectSignature()).forEachType([this, &eraseGuard](componenttypeid_t typeId) {
+                eraseGuard(m_vecTypeIdToQueryGuards[typeId]);
+            });
+
             m_mapQueryIDToQueryGuard.erase( it );
         }
     }
@@ -299,9 +649,117 @@ namespace chestnut::ecs
 
     inline void CEntityWorld::updateQueriesOnEntityChange( entityid_t entity, const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
     {
+        if( m_batchDepth == 0 )
+        {
+            testQueriesOnEntityChange( &entity, 1, prevSignature, currSignature );
+        }
+        else
+        {
+            markQueriesOnBatchedChange( prevSignature, currSignature );
+            recordBatchedEntityChange( entity, prevSignature, currSignature );
+        }
+    }
+
+    inline void CEntityWorld::updateQueriesOnEntitiesChange( const std::vector<entityid_t>& entities, const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
+    {
+        if( m_batchDepth == 0 )
+        {
+            testQueriesOnEntityChange( entities.data(), (entitysize_t)entities.size(), prevSignature, currSignature );
+        }
+        else
+        {
+            markQueriesOnBatchedChange( prevSignature, currSignature );
+
+            for( entityid_t entity : entities )
+            {
+                recordBatchedEntityChange( entity, prevSignature, currSignature );
+            }
+        }
+    }
+
+    inline void CEntityWorld::recordBatchedEntityChange( entityid_t entity, const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
+    {
+        const int slot = m_batchedEntitySlots[entity];
+
+        if( slot == internal::CPagedSparseArray::NIL_INDEX )
+        {
+            // only the state from before the first change matters
+            m_batchedEntitySlots.set( entity, (int)m_vecBatchedEntities.size() );
+            m_vecBatchedEntities.push_back({ 
+                entity, 
+                prevSignature ? *prevSignature : CEntitySignature(), 
+                prevSignature != nullptr,
+                currSignature == nullptr,
+                false,
+                false
+            });
+            return;
+        }
+
+        SBatchedEntity& batched = m_vecBatchedEntities[slot];
+
+        if( !currSignature )
+        {
+            batched.wasDestroyed = true;
+            batched.changedAfterDestroy = false;
+        }
+        else if( batched.wasDestroyed && !batched.changedAfterDestroy )
+        {
+            // first change of a new entity that took the ID
+            batched.changedAfterDestroy = true;
+            batched.hadSignatureAfterDestroy = prevSignature != nullptr;
+        }
+    }
+
+    inline void CEntityWorld::markQueriesOnBatchedChange( const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
+    {
+        // only archetype tables can be walked by queries past what they've been given
+        if( m_componentStorage.backend() != EComponentStorageBackend::ARCHETYPE )
+        {
+            return;
+        }
+
+        gatherQueryGuardsOnEntityChange( prevSignature, currSignature );
+
+        for( internal::CEntityQueryGuard *guard : m_vecQueryGuardsToUpdate )
+        {
+            guard->markBatchedChanges();
+        }
+    }
+
+    inline void CEntityWorld::addToEntityGroup(std::vector<SEntityGroup>& groups, const CEntitySignature& signature, entityid_t entity, const CEntitySignature& nextSignature)
+    {
+        // entities usually come in runs of the same signature, so check the most recent group first
+        auto group = std::find_if(groups.rbegin(), groups.rend(), [&signature, &nextSignature](const SEntityGroup& g) {
+            return g.signature == signature && g.nextSignature == nextSignature;
+        });
+
+        if(group != groups.rend())
+        {
+            group->entities.push_back(entity);
+        }
+        else
+        {
+            groups.push_back({signature, {entity}, nextSignature});
+        }
+    }
+
+    inline void CEntityWorld::testQueriesOnEntityChange( const entityid_t *entities, entitysize_t entityCount, const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
+    {
+        if( entityCount == 0 )
+        {
+            return;
+        }
+
         bool prevValid, currValid;
 
-        for( auto& [ id, guard ] : m_mapQueryIDToQueryGuard )
+        gatherQueryGuardsOnEntityChange( prevSignature, currSignature );
+
+        // a query mentioning several of the changed types must be tested only once
+        std::sort(m_vecQueryGuardsToUpdate.begin(), m_vecQueryGuardsToUpdate.end());
+        m_vecQueryGuardsToUpdate.erase(std::unique(m_vecQueryGuardsToUpdate.begin(), m_vecQueryGuardsToUpdate.end()), m_vecQueryGuardsToUpdate.end());
+
+        for( internal::CEntityQueryGuard *guard : m_vecQueryGuardsToUpdate )
         {
             if( prevSignature )
             {
@@ -323,13 +781,34 @@ namespace chestnut::ecs
 
             if( !prevValid && currValid )
             {
-                guard->enqueueEntity( entity );
+                guard->enqueueEntities( entities, entityCount );
             }
             else if( prevValid && !currValid )
             {
-                guard->dequeueEntity( entity );
+                guard->dequeueEntities( entities, entityCount );
             }
         }
     }
 
+    inline void CEntityWorld::gatherQueryGuardsOnEntityChange( const CEntitySignature* prevSignature, const CEntitySignature* currSignature )
+    {
+        const CEntitySignature emptySignature;
+        const CEntitySignature changedTypes = (prevSignature ? *prevSignature : emptySignature) ^ (currSignature ? *currSignature : emptySignature);
+
+        m_vecQueryGuardsToUpdate.clear();
+        changedTypes.forEachType([this](componenttypeid_t typeId) {
+            if(typeId < m_vecTypeIdToQueryGuards.size())
+            {
+                const auto& guards = m_vecTypeIdToQueryGuards[typeId];
+                m_vecQueryGuardsToUpdate.insert(m_vecQueryGuardsToUpdate.end(), guards.begin(), guards.end());
+            }
+        });
+
+        // entity appearing or disappearing as a whole can affect queries that don't require anything
+        if( !prevSignature || !currSignature )
+        {
+            m_vecQueryGuardsToUpdate.insert(m_vecQueryGuardsToUpdate.end(), m_vecUnconstrainedQueryGuards.begin(), m_vecUnconstrainedQueryGuards.end());
+        }
+    }
+
 } // namespace chestnut::ecs
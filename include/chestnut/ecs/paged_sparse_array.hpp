@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+namespace chestnut::ecs::internal
+{
+    /**
+     * @brief Sparse array of dense indices split into fixed-size pages that get allocated on demand
+     *
+     * @details
+     * Ranges of the array that don't hold any index share a single read-only null page,
+     * so reads never need to check whether a page exists and memory usage follows the amount of
+     * non-NIL entries instead of the highest index ever written. A page whose entries all went back
+     * to NIL_INDEX stays allocated until reset() or resize(), so an entity toggling a component
+     * doesn't allocate and free the same page over and over.
+     *
+     * Like the rest of the storage, members that allocate pages are noexcept,
+     * so running out of memory while growing the array terminates the program.
+     */
+    class CPagedSparseArray
+    {
+    public:
+        using index_type = unsigned int;
+
+        inline static const int NIL_INDEX = -1;
+        inline static const index_type PAGE_SIZE = 4096;
+
+    private:
+        /**
+         * @brief Page table; unused entries point to the shared null page
+         */
+        std::vector<int *> m_vecPages;
+        /**
+         * @brief Amount of non-NIL entries in each of the pages
+         */
+        std::vector<index_type> m_vecPageUsage;
+        /**
+         * @brief Logical size of the array
+         */
+        index_type m_size;
+
+
+    public:
+        CPagedSparseArray() noexcept;
+        CPagedSparseArray(index_type initSize) noexcept;
+
+        CPagedSparseArray(const CPagedSparseArray& other) noexcept;
+        CPagedSparseArray& operator=(const CPagedSparseArray& other) noexcept;
+
+        CPagedSparseArray(CPagedSparseArray&& other) noexcept;
+        CPagedSparseArray& operator=(CPagedSparseArray&& other) noexcept;
+
+        ~CPagedSparseArray();
+
+
+        /**
+         * @brief Returns the value at given index or NIL_INDEX if index is out of range
+         */
+        int operator[](index_type idx) const noexcept;
+
+        /**
+         * @brief Sets the value at given index, growing the array if needed
+         *
+         * @details Writing NIL_INDEX into an unallocated page or past the size doesn't allocate anything.
+         */
+        void set(index_type idx, int value) noexcept;
+
+        /**
+         * @brief Resets every entry to NIL_INDEX and releases all pages; logical size stays the same
+         */
+        void reset() noexcept;
+
+        /**
+         * @brief Changes the logical size of the array; releases pages that go out of range
+         */
+        void resize(index_type size) noexcept;
+
+
+        index_type size() const noexcept;
+
+        /**
+         * @brief Returns the number of pages that currently hold memory (excluding the null page)
+         */
+        index_type allocatedPageCount() const noexcept;
+
+    private:
+        static int *nullPage() noexcept;
+
+        void releasePage(index_type page) noexcept;
+    };
+
+} // namespace chestnut::ecs::internal
+
+
+#include "paged_sparse_array.inl"
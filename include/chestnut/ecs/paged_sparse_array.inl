@@ -0,0 +1,201 @@
+#include <algorithm> // std::fill_n, std::copy_n
+
+namespace chestnut::ecs::internal
+{
+
+inline CPagedSparseArray::CPagedSparseArray() noexcept
+: m_size(0)
+{
+
+}
+
+inline CPagedSparseArray::CPagedSparseArray(index_type initSize) noexcept
+: m_size(0)
+{
+    resize(initSize);
+}
+
+inline CPagedSparseArray::CPagedSparseArray(const CPagedSparseArray& other) noexcept
+: m_vecPages(other.m_vecPages.size(), nullPage()), m_vecPageUsage(other.m_vecPageUsage), m_size(other.m_size)
+{
+    for(index_type page = 0; page < (index_type)m_vecPages.size(); page++)
+    {
+        if(other.m_vecPages[page] != nullPage())
+        {
+            m_vecPages[page] = new int[PAGE_SIZE];
+            std::copy_n(other.m_vecPages[page], PAGE_SIZE, m_vecPages[page]);
+        }
+    }
+}
+
+inline CPagedSparseArray& CPagedSparseArray::operator=(const CPagedSparseArray& other) noexcept
+{
+    if(this != &other)
+    {
+        CPagedSparseArray copy(other);
+        *this = std::move(copy);
+    }
+
+    return *this;
+}
+
+inline CPagedSparseArray::CPagedSparseArray(CPagedSparseArray&& other) noexcept
+: m_vecPages(std::move(other.m_vecPages)), m_vecPageUsage(std::move(other.m_vecPageUsage)), m_size(other.m_size)
+{
+    other.m_vecPages.clear();
+    other.m_vecPageUsage.clear();
+    other.m_size = 0;
+}
+
+inline CPagedSparseArray& CPagedSparseArray::operator=(CPagedSparseArray&& other) noexcept
+{
+    if(this != &other)
+    {
+        reset();
+
+        m_vecPages = std::move(other.m_vecPages);
+        m_vecPageUsage = std::move(other.m_vecPageUsage);
+        m_size = other.m_size;
+
+        other.m_vecPages.clear();
+        other.m_vecPageUsage.clear();
+        other.m_size = 0;
+    }
+
+    return *this;
+}
+
+inline CPagedSparseArray::~CPagedSparseArray()
+{
+    reset();
+}
+
+
+
+
+inline int CPagedSparseArray::operator[](index_type idx) const noexcept
+{
+    const index_type page = idx / PAGE_SIZE;
+
+    if(page >= m_vecPages.size())
+    {
+        return NIL_INDEX;
+    }
+
+    return m_vecPages[page][idx % PAGE_SIZE];
+}
+
+inline void CPagedSparseArray::set(index_type idx, int value) noexcept
+{
+    if(idx >= m_size)
+    {
+        // entries past the size already read as NIL_INDEX
+        if(value == NIL_INDEX)
+        {
+            return;
+        }
+
+        resize(idx + 1);
+    }
+
+    const index_type page = idx / PAGE_SIZE;
+    const index_type offset = idx % PAGE_SIZE;
+
+    if(m_vecPages[page] == nullPage())
+    {
+        if(value == NIL_INDEX)
+        {
+            return;
+        }
+
+        m_vecPages[page] = new int[PAGE_SIZE];
+        std::fill_n(m_vecPages[page], PAGE_SIZE, NIL_INDEX);
+    }
+
+    int& entry = m_vecPages[page][offset];
+
+    if(entry == NIL_INDEX && value != NIL_INDEX)
+    {
+        m_vecPageUsage[page]++;
+    }
+    else if(entry != NIL_INDEX && value == NIL_INDEX)
+    {
+        m_vecPageUsage[page]--;
+    }
+
+    entry = value;
+}
+
+inline void CPagedSparseArray::reset() noexcept
+{
+    for(index_type page = 0; page < (index_type)m_vecPages.size(); page++)
+    {
+        releasePage(page);
+    }
+}
+
+inline void CPagedSparseArray::resize(index_type size) noexcept
+{
+    const index_type pageCount = (index_type)((size + (size_t)PAGE_SIZE - 1) / PAGE_SIZE);
+
+    for(index_type page = pageCount; page < (index_type)m_vecPages.size(); page++)
+    {
+        releasePage(page);
+    }
+
+    m_vecPages.resize(pageCount, nullPage());
+    m_vecPageUsage.resize(pageCount, 0);
+    m_size = size;
+
+    // clear the leftover part of the last page
+    if(pageCount > 0 && m_vecPages.back() != nullPage())
+    {
+        const index_type lastPage = pageCount - 1;
+        int *entries = m_vecPages[lastPage];
+
+        for(index_type offset = size - lastPage * PAGE_SIZE; offset < PAGE_SIZE; offset++)
+        {
+            if(entries[offset] != NIL_INDEX)
+            {
+                entries[offset] = NIL_INDEX;
+                m_vecPageUsage[lastPage]--;
+            }
+        }
+
+        if(m_vecPageUsage[lastPage] == 0)
+        {
+            releasePage(lastPage);
+        }
+    }
+}
+
+inline CPagedSparseArray::index_type CPagedSparseArray::size() const noexcept
+{
+    return m_size;
+}
+
+inline CPagedSparseArray::index_type CPagedSparseArray::allocatedPageCount() const noexcept
+{
+    return (index_type)std::count_if(m_vecPages.begin(), m_vecPages.end(), [](const int *page) {
+        return page != nullPage();
+    });
+}
+
+inline int *CPagedSparseArray::nullPage() noexcept
+{
+    static std::vector<int> s_nullPage(PAGE_SIZE, NIL_INDEX);
+    return s_nullPage.data();
+}
+
+inline void CPagedSparseArray::releasePage(index_type page) noexcept
+{
+    if(m_vecPages[page] != nullPage())
+    {
+        delete[] m_vecPages[page];
+        m_vecPages[page] = nullPage();
+    }
+
+    m_vecPageUsage[page] = 0;
+}
+
+} // namespace chestnut::ecs::internal
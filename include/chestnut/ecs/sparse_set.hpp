@@ -1,5 +1,7 @@
 #pragma once
 
+#include "paged_sparse_array.hpp"
+
 #include <type_traits>
 #include <vector>
 
@@ -8,12 +10,12 @@ namespace chestnut::ecs::internal
     class CSparseSetBase
     {
     protected:
-        mutable std::vector<int> m_sparse;
+        CPagedSparseArray m_sparse;
 
     public:
-        using index_type = unsigned int;
+        using index_type = CPagedSparseArray::index_type;
 
-        inline static const int NIL_INDEX = -1;
+        inline static const int NIL_INDEX = CPagedSparseArray::NIL_INDEX;
 
 
 
@@ -30,11 +32,13 @@ namespace chestnut::ecs::internal
         virtual ~CSparseSetBase() = default;
 
 
-        const std::vector<int>& sparse() const noexcept;   
+        const CPagedSparseArray& sparse() const noexcept;   
 
         bool contains(index_type idx) const noexcept;    
 
         virtual void erase(index_type idx) noexcept;
+        // erases every given index, skipping ones not in the set
+        virtual void eraseMany(const index_type *indices, index_type count) noexcept;
     };
 
 
@@ -42,15 +46,14 @@ namespace chestnut::ecs::internal
     template<typename T>
     class CSparseSet : public CSparseSetBase
     {
-    public:
-        struct SDenseElement 
-        {
-            T e;
-            index_type i;
-        };
-
     private:
-        std::vector<SDenseElement> m_dense;
+        // tag types carry no data, so instead of an array of them the set keeps one instance that all elements share
+        inline static constexpr bool IS_TAG = std::is_empty_v<T>;
+
+        // dense elements and the sparse indices they belong to are kept in parallel arrays,
+        // so that iterating over elements doesn't drag the indices through the cache
+        std::conditional_t<IS_TAG, T, std::vector<T>> m_dense;
+        std::vector<index_type> m_denseIndices;
 
 
     public:
@@ -64,7 +67,15 @@ namespace chestnut::ecs::internal
         CSparseSet& operator=(CSparseSet&& other) noexcept;
 
 
-        const std::vector<SDenseElement>& dense() const noexcept;
+        // tag types have no dense array, so for them dense() doesn't compile; use data() and size() instead
+        const std::vector<T>& dense() const noexcept;
+        const std::vector<index_type>& denseIndices() const noexcept;
+
+        // contiguous views into the dense arrays, both size() elements long;
+        // for tag types data() points to the single shared instance
+        T *data() noexcept;
+        const T *data() const noexcept;
+        const index_type *indices() const noexcept;
 
 
         T& at(index_type idx);
@@ -74,8 +85,12 @@ namespace chestnut::ecs::internal
         index_type size() const noexcept;
 
         void clear() noexcept;
+        // reserves space in dense arrays for given total number of elements
+        void reserve(index_type capacity) noexcept;
         void insert(index_type idx, T&& arg) noexcept;
         void erase(index_type idx) noexcept override;
+        // when a large part of the set goes away, compacts dense arrays in a single pass instead of swap-removing one by one
+        void eraseMany(const index_type *indices, index_type count) noexcept override;
     };
     
 } // namespace chestnut::ecs::internal
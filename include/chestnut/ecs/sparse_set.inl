@@ -1,13 +1,12 @@
 #include "exceptions.hpp"
 
-#include <algorithm> // std::fill
 #include <stdexcept>
 
 namespace chestnut::ecs::internal
 {
 
 inline CSparseSetBase::CSparseSetBase(index_type initSparseSize) noexcept
-: m_sparse(initSparseSize, NIL_INDEX)
+: m_sparse(initSparseSize)
 {
 
 }
@@ -36,26 +35,26 @@ inline CSparseSetBase& CSparseSetBase::operator=(CSparseSetBase&& other) noexcep
     return *this;
 }
 
-inline const std::vector<int>& CSparseSetBase::sparse() const noexcept
+inline const CPagedSparseArray& CSparseSetBase::sparse() const noexcept
 {
     return m_sparse;
 }
 
 inline bool CSparseSetBase::contains(index_type idx) const noexcept
 {
-    if(idx >= m_sparse.size())
-    {
-        return false;
-    }
-
     return m_sparse[idx] != NIL_INDEX;
 }
 
 inline void CSparseSetBase::erase(index_type idx) noexcept
 {
-    if(idx < m_sparse.size())
+    m_sparse.set(idx, NIL_INDEX);
+}
+
+inline void CSparseSetBase::eraseMany(const index_type *indices, index_type count) noexcept
+{
+    for(index_type i = 0; i < count; i++)
     {
-        m_sparse[idx] = NIL_INDEX;   
+        erase(indices[i]);
     }
 }
 
@@ -68,14 +67,14 @@ inline void CSparseSetBase::erase(index_type idx) noexcept
 
 template<typename T>
 CSparseSet<T>::CSparseSet(index_type initSparseSize) noexcept
-: CSparseSetBase(initSparseSize), m_dense()
+: CSparseSetBase(initSparseSize), m_dense(), m_denseIndices()
 {
 
 }
 
 template<typename T>
 CSparseSet<T>::CSparseSet(const CSparseSet<T>& other) noexcept
-: CSparseSetBase(other), m_dense(other.m_dense)
+: CSparseSetBase(other), m_dense(other.m_dense), m_denseIndices(other.m_denseIndices)
 {
 
 }
@@ -85,12 +84,13 @@ CSparseSet<T>& CSparseSet<T>::operator=(const CSparseSet<T>& other) noexcept
 {   
     CSparseSetBase::operator=(other);
     this->m_dense = other.m_dense;
+    this->m_denseIndices = other.m_denseIndices;
     return *this;
 }
 
 template<typename T>
 CSparseSet<T>::CSparseSet(CSparseSet<T>&& other) noexcept
-: CSparseSetBase(std::move(other)), m_dense(std::move(other.m_dense))
+: CSparseSetBase(std::move(other)), m_dense(std::move(other.m_dense)), m_denseIndices(std::move(other.m_denseIndices))
 {
 
 }
@@ -100,89 +100,230 @@ CSparseSet<T>& CSparseSet<T>::operator=(CSparseSet<T>&& other) noexcept
 {
     CSparseSetBase::operator=(std::move(other));
     this->m_dense = std::move(other.m_dense);
+    this->m_denseIndices = std::move(other.m_denseIndices);
     return *this;
 }
 
 template<typename T>
-const std::vector<typename CSparseSet<T>::SDenseElement>& CSparseSet<T>::dense() const noexcept
+const std::vector<T>& CSparseSet<T>::dense() const noexcept
 {
+    static_assert(!IS_TAG, "Tag types have no dense array, use data() and size() instead");
     return this->m_dense;
 }
 
+template<typename T>
+const std::vector<CSparseSetBase::index_type>& CSparseSet<T>::denseIndices() const noexcept
+{
+    return this->m_denseIndices;
+}
+
+template<typename T>
+T *CSparseSet<T>::data() noexcept
+{
+    if constexpr(IS_TAG)
+    {
+        return &this->m_dense;
+    }
+    else
+    {
+        return this->m_dense.data();
+    }
+}
+
+template<typename T>
+const T *CSparseSet<T>::data() const noexcept
+{
+    if constexpr(IS_TAG)
+    {
+        return &this->m_dense;
+    }
+    else
+    {
+        return this->m_dense.data();
+    }
+}
+
+template<typename T>
+const CSparseSetBase::index_type *CSparseSet<T>::indices() const noexcept
+{
+    return this->m_denseIndices.data();
+}
+
 template<typename T>
 T& CSparseSet<T>::at(index_type idx) 
 {
-    if(idx >= m_sparse.size() || m_sparse[idx] == NIL_INDEX)
+    const int denseIdx = m_sparse[idx];
+    if(denseIdx == NIL_INDEX)
     {
         throw BadStorageAccessException();
     }
 
-    return this->m_dense[m_sparse[idx]].e;
+    if constexpr(IS_TAG)
+    {
+        return this->m_dense;
+    }
+    else
+    {
+        return this->m_dense[denseIdx];
+    }
 }
 
 template<typename T>
 const T& CSparseSet<T>::at(index_type idx) const
 {
-    if(idx >= m_sparse.size() || m_sparse[idx] == NIL_INDEX)
+    const int denseIdx = m_sparse[idx];
+    if(denseIdx == NIL_INDEX)
     {
         throw BadStorageAccessException();
     }
 
-    return this->m_dense[m_sparse[idx]].e;
+    if constexpr(IS_TAG)
+    {
+        return this->m_dense;
+    }
+    else
+    {
+        return this->m_dense[denseIdx];
+    }
 }
 
 template<typename T>
 bool CSparseSet<T>::empty() const noexcept
 {
-    return m_dense.empty();
+    return m_denseIndices.empty();
 }
 
 template<typename T>
 CSparseSetBase::index_type CSparseSet<T>::size() const noexcept
 {
-    return (CSparseSetBase::index_type)m_dense.size();
+    return (CSparseSetBase::index_type)m_denseIndices.size();
 }
 
 template<typename T>
 void CSparseSet<T>::clear() noexcept
 {
-    m_dense.clear();
+    if constexpr(!IS_TAG)
+    {
+        m_dense.clear();
+    }
+    m_denseIndices.clear();
 
-    std::fill(m_sparse.begin(), m_sparse.end(), NIL_INDEX);
+    m_sparse.reset();
 }
 
 template<typename T>
-void CSparseSet<T>::insert(index_type idx, T&& arg) noexcept
+void CSparseSet<T>::reserve(index_type capacity) noexcept
 {
-    if(idx >= m_sparse.size())
+    if constexpr(!IS_TAG)
     {
-        m_sparse.resize(idx + 1, NIL_INDEX);
+        m_dense.reserve(capacity);
     }
+    m_denseIndices.reserve(capacity);
+}
 
-    if(m_sparse[idx] != NIL_INDEX)
+template<typename T>
+void CSparseSet<T>::insert(index_type idx, T&& arg) noexcept
+{
+    const int denseIdx = m_sparse[idx];
+    if(denseIdx != NIL_INDEX)
     {
-        m_dense[m_sparse[idx]].e = std::forward<T>(arg);
+        if constexpr(!IS_TAG)
+        {
+            m_dense[denseIdx] = std::forward<T>(arg);
+        }
     }
     else
     {
-        m_dense.push_back({
-            std::forward<T>(arg),
-            idx
-        });
-        m_sparse[idx] = (CSparseSetBase::index_type)(m_dense.size() - 1);
+        if constexpr(!IS_TAG)
+        {
+            m_dense.push_back(std::forward<T>(arg));
+        }
+        m_denseIndices.push_back(idx);
+        m_sparse.set(idx, (int)(m_denseIndices.size() - 1));
     }
 }
 
 template<typename T>
 void CSparseSet<T>::erase(index_type idx) noexcept
 {
-    if(idx < m_sparse.size() && m_sparse[idx] != NIL_INDEX)
+    const int denseIdx = m_sparse[idx];
+    if(denseIdx != NIL_INDEX)
+    {
+        const int lastIdx = (int)m_denseIndices.size() - 1;
+        if(denseIdx != lastIdx)
+        {
+            if constexpr(!IS_TAG)
+            {
+                m_dense[denseIdx] = std::move(m_dense[lastIdx]);
+            }
+            m_denseIndices[denseIdx] = m_denseIndices[lastIdx];
+            m_sparse.set(m_denseIndices[denseIdx], denseIdx);
+        }
+
+        if constexpr(!IS_TAG)
+        {
+            m_dense.pop_back();
+        }
+        m_denseIndices.pop_back();
+        m_sparse.set(idx, NIL_INDEX);
+    }
+}
+
+template<typename T>
+void CSparseSet<T>::eraseMany(const index_type *indices, index_type count) noexcept
+{
+    // swap-removes jump around the dense arrays, a full sweep is cheaper once enough elements go
+    if(count < size() / 4)
+    {
+        for(index_type i = 0; i < count; i++)
+        {
+            erase(indices[i]);
+        }
+        return;
+    }
+
+    index_type erasedCount = 0;
+    for(index_type i = 0; i < count; i++)
+    {
+        if(m_sparse[indices[i]] != NIL_INDEX)
+        {
+            m_sparse.set(indices[i], NIL_INDEX);
+            erasedCount++;
+        }
+    }
+
+    if(erasedCount == size())
+    {
+        // every sparse index is already nil
+        clear();
+        return;
+    }
+
+    // stable compaction, surviving elements keep their relative order
+    index_type writeIdx = 0;
+    for(index_type readIdx = 0; readIdx < size(); readIdx++)
+    {
+        const index_type idx = m_denseIndices[readIdx];
+        if(m_sparse[idx] != NIL_INDEX)
+        {
+            if(writeIdx != readIdx)
+            {
+                if constexpr(!IS_TAG)
+                {
+                    m_dense[writeIdx] = std::move(m_dense[readIdx]);
+                }
+                m_denseIndices[writeIdx] = idx;
+                m_sparse.set(idx, (int)writeIdx);
+            }
+            writeIdx++;
+        }
+    }
+
+    if constexpr(!IS_TAG)
     {
-        m_sparse[m_dense.back().i] = m_sparse[idx];
-        std::swap(m_dense[m_sparse[idx]], m_dense.back());
-        m_dense.pop_back();
-        m_sparse[idx] = NIL_INDEX;
+        m_dense.erase(m_dense.begin() + writeIdx, m_dense.end());
     }
+    m_denseIndices.resize(writeIdx);
 }
 
 } // namespace chestnut::ecs::internal
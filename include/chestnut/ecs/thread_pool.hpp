@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chestnut::ecs
+{
+    /**
+     * @brief Pool of worker threads that share work by stealing tasks from each other's queues
+     *
+     * @details
+     * Threads are created once in the constructor and sleep while there's no work,
+     * so dispatching work to the pool doesn't spawn any threads.
+     * The thread that starts parallelFor helps with executing tasks until all of them are done.
+     */
+    class CThreadPool
+    {
+    private:
+        struct SJob
+        {
+            void (*invoke)(void *func, unsigned int taskIdx);
+            void *func;
+            std::atomic<unsigned int> remainingTaskCount;
+            std::atomic<bool> hasFailed;
+            std::exception_ptr exception;
+        };
+
+        struct STask
+        {
+            SJob *job;
+            unsigned int taskIdx;
+        };
+
+        struct SWorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<STask> tasks;
+        };
+
+        std::vector<std::unique_ptr<SWorkerQueue>> m_vecQueues;
+        std::vector<std::thread> m_vecWorkers;
+
+        // number of tasks sitting in queues, used to decide whether workers can go to sleep
+        std::atomic<unsigned int> m_pendingTaskCount;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_sleepCondition;
+        bool m_isStopping;
+
+        // which pool and worker the current thread belongs to, if any
+        inline static thread_local const CThreadPool *s_currentPool = nullptr;
+        inline static thread_local unsigned int s_currentWorkerIdx = 0;
+
+
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param workerCount number of worker threads; if 0, all work is done on the calling thread
+         */
+        explicit CThreadPool(unsigned int workerCount = defaultWorkerCount());
+
+        CThreadPool(const CThreadPool&) = delete;
+        CThreadPool& operator=(const CThreadPool&) = delete;
+
+        /**
+         * @brief Destructor; waits for workers to finish queued tasks
+         */
+        ~CThreadPool();
+
+
+        unsigned int getWorkerCount() const noexcept;
+
+        /**
+         * @brief Calls func(taskIdx) for every taskIdx in [0, taskCount) on the pool and blocks until all calls are done
+         *
+         * @details
+         * If any of the calls throws, the first exception is rethrown here after all tasks have finished.
+         * Remaining tasks are skipped once a call has thrown.
+         *
+         * @param taskCount number of tasks
+         * @param func callable taking unsigned int task index; called concurrently from many threads
+         */
+        template<typename F>
+        void parallelFor(unsigned int taskCount, F&& func);
+
+        /**
+         * @brief Returns the index of the current thread within the pool
+         *
+         * @return 1 + worker index for pool's worker threads, 0 for any other thread
+         */
+        unsigned int currentThreadSlot() const noexcept;
+
+        /**
+         * @brief Number of distinct values currentThreadSlot() can return
+         */
+        unsigned int getThreadSlotCount() const noexcept;
+
+
+        /**
+         * @brief Returns the pool shared by the whole process, created on first use
+         */
+        static CThreadPool& getDefault();
+
+        static unsigned int defaultWorkerCount() noexcept;
+
+    private:
+        void workerLoop(unsigned int workerIdx);
+
+        bool popTask(unsigned int queueIdx, STask& task);
+        bool stealTask(unsigned int thiefIdx, STask& task);
+        static void runTask(const STask& task) noexcept;
+    };
+
+} // namespace chestnut::ecs
+
+
+#include "thread_pool.inl"
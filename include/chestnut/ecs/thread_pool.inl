@@ -0,0 +1,248 @@
+#include <type_traits> // remove_reference_t
+
+namespace chestnut::ecs
+{
+
+inline CThreadPool::CThreadPool(unsigned int workerCount)
+: m_pendingTaskCount(0), m_isStopping(false)
+{
+    for(unsigned int i = 0; i < workerCount; i++)
+    {
+        m_vecQueues.push_back(std::make_unique<SWorkerQueue>());
+    }
+
+    for(unsigned int i = 0; i < workerCount; i++)
+    {
+        m_vecWorkers.emplace_back(&CThreadPool::workerLoop, this, i);
+    }
+}
+
+inline CThreadPool::~CThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_sleepCondition.notify_all();
+
+    for(std::thread& worker : m_vecWorkers)
+    {
+        worker.join();
+    }
+}
+
+
+
+
+inline unsigned int CThreadPool::getWorkerCount() const noexcept
+{
+    return (unsigned int)m_vecWorkers.size();
+}
+
+template<typename F>
+void CThreadPool::parallelFor(unsigned int taskCount, F&& func)
+{
+    if(taskCount == 0)
+    {
+        return;
+    }
+
+    using FuncType = std::remove_reference_t<F>;
+
+    SJob job;
+    job.invoke = [](void *f, unsigned int taskIdx) {
+        (*static_cast<FuncType *>(f))(taskIdx);
+    };
+    job.func = const_cast<void *>(static_cast<const void *>(&func));
+    job.remainingTaskCount = taskCount;
+    job.hasFailed = false;
+
+    if(m_vecQueues.empty())
+    {
+        for(unsigned int i = 0; i < taskCount; i++)
+        {
+            runTask(STask{&job, i});
+        }
+    }
+    else
+    {
+        const bool isOwnWorker = s_currentPool == this;
+        const unsigned int queueCount = (unsigned int)m_vecQueues.size();
+
+        // count goes up first so that it never drops below zero when workers start popping
+        m_pendingTaskCount.fetch_add(taskCount);
+
+        if(isOwnWorker)
+        {
+            // nested call; other workers will steal from this one
+            SWorkerQueue& queue = *m_vecQueues[s_currentWorkerIdx];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for(unsigned int i = 0; i < taskCount; i++)
+            {
+                queue.tasks.push_back(STask{&job, i});
+            }
+        }
+        else
+        {
+            for(unsigned int q = 0; q < queueCount; q++)
+            {
+                const unsigned int begin = (unsigned int)((unsigned long long)taskCount * q / queueCount);
+                const unsigned int end = (unsigned int)((unsigned long long)taskCount * (q + 1) / queueCount);
+
+                SWorkerQueue& queue = *m_vecQueues[q];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                for(unsigned int i = begin; i < end; i++)
+                {
+                    queue.tasks.push_back(STask{&job, i});
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_sleepCondition.notify_all();
+
+        // help out instead of idly waiting
+        const unsigned int selfIdx = isOwnWorker ? s_currentWorkerIdx : 0;
+        while(job.remainingTaskCount.load(std::memory_order_acquire) > 0)
+        {
+            STask task;
+            if((isOwnWorker && popTask(selfIdx, task)) || stealTask(selfIdx, task))
+            {
+                runTask(task);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    if(job.hasFailed)
+    {
+        std::rethrow_exception(job.exception);
+    }
+}
+
+inline unsigned int CThreadPool::currentThreadSlot() const noexcept
+{
+    return s_currentPool == this ? s_currentWorkerIdx + 1 : 0;
+}
+
+inline unsigned int CThreadPool::getThreadSlotCount() const noexcept
+{
+    return getWorkerCount() + 1;
+}
+
+
+
+
+inline CThreadPool& CThreadPool::getDefault()
+{
+    static CThreadPool s_pool;
+    return s_pool;
+}
+
+inline unsigned int CThreadPool::defaultWorkerCount() noexcept
+{
+    // calling thread takes part in the work too
+    const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+
+
+
+inline void CThreadPool::workerLoop(unsigned int workerIdx)
+{
+    s_currentPool = this;
+    s_currentWorkerIdx = workerIdx;
+
+    while(true)
+    {
+        STask task;
+        if(popTask(workerIdx, task) || stealTask(workerIdx, task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.wait(lock, [this] {
+            return m_isStopping || m_pendingTaskCount.load() > 0;
+        });
+
+        if(m_isStopping && m_pendingTaskCount.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+inline bool CThreadPool::popTask(unsigned int queueIdx, STask& task)
+{
+    SWorkerQueue& queue = *m_vecQueues[queueIdx];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if(queue.tasks.empty())
+    {
+        return false;
+    }
+
+    // newest task first, its data is most likely still in cache
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    m_pendingTaskCount.fetch_sub(1);
+
+    return true;
+}
+
+inline bool CThreadPool::stealTask(unsigned int thiefIdx, STask& task)
+{
+    const unsigned int queueCount = (unsigned int)m_vecQueues.size();
+
+    for(unsigned int i = 1; i <= queueCount; i++)
+    {
+        SWorkerQueue& queue = *m_vecQueues[(thiefIdx + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(!queue.tasks.empty())
+        {
+            // oldest task, opposite end to the one the owner pops from
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            m_pendingTaskCount.fetch_sub(1);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline void CThreadPool::runTask(const STask& task) noexcept
+{
+    SJob *job = task.job;
+
+    if(!job->hasFailed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            job->invoke(job->func, task.taskIdx);
+        }
+        catch(...)
+        {
+            bool expected = false;
+            if(job->hasFailed.compare_exchange_strong(expected, true))
+            {
+                job->exception = std::current_exception();
+            }
+        }
+    }
+
+    // job may be gone right after this, don't touch it anymore
+    job->remainingTaskCount.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+} // namespace chestnut::ecs
@@ -16,10 +16,6 @@
 
 namespace chestnut::ecs
 {
-    //TODO CEntity
-    //TODO entity will have two IDs
-    //     one is fast for internal use and other universally unique to identify entities on the outside
-    //     fast ID should not be accessible to the user 
     /**
      * @brief Type for the ID of the entity
      * 
@@ -30,5 +26,14 @@ namespace chestnut::ecs
      * @brief Type for quantity of entities (the type is the same as entityid_t)
      */
     typedef entityid_t entitysize_t;
+    /**
+     * @brief Type for the version (generation) of the entity ID, incremented every time an entity with that ID gets destroyed
+     */
+    typedef uint32_t entityversion_t;
+
+    /**
+     * @brief Type for the dense ID assigned to each component type at its first use
+     */
+    typedef uint16_t componenttypeid_t;
 
 } // namespace chestnut::ecs
@@ -0,0 +1,177 @@
+#include <catch2/catch.hpp>
+
+#include "../include/chestnut/ecs/archetype_storage.hpp"
+
+#include <string>
+
+using namespace chestnut::ecs;
+using namespace chestnut::ecs::internal;
+
+namespace
+{
+    struct FooComp
+    {
+        int i;
+    };
+
+    struct BarComp
+    {
+        char c;
+    };
+
+    struct BazComp
+    {
+        std::string s;
+    };
+
+} // namespace
+
+
+TEST_CASE( "Archetype storage test" )
+{
+    CArchetypeStorage storage;
+
+    SECTION("Initial state")
+    {
+        REQUIRE(storage.archetypeCount() == 0);
+        REQUIRE(storage.size<FooComp>() == 0);
+        REQUIRE_FALSE(storage.contains<FooComp>(0));
+        REQUIRE(storage.archetypeOf(0) == nullptr);
+        REQUIRE_THROWS(storage.at<FooComp>(0));
+    }
+
+    SECTION("Insertion")
+    {
+        storage.insert<FooComp>(0, {0});
+        storage.insert<FooComp>(1, {1});
+        storage.insert<BarComp>(1, {'a'});
+        storage.insert<BazComp>(2, {"baz"});
+        storage.insert<FooComp>(1, {10});
+
+        REQUIRE(storage.archetypeCount() == 3);
+        REQUIRE(storage.size<FooComp>() == 2);
+        REQUIRE(storage.size<BarComp>() == 1);
+        REQUIRE(storage.size<BazComp>() == 1);
+
+        REQUIRE(storage.contains<FooComp>(0));
+        REQUIRE_FALSE(storage.contains<BarComp>(0));
+        REQUIRE(storage.contains<FooComp>(1));
+        REQUIRE(storage.contains<BarComp>(1));
+        REQUIRE_FALSE(storage.contains<FooComp>(2));
+
+        REQUIRE(storage.at<FooComp>(0).i == 0);
+        REQUIRE(storage.at<FooComp>(1).i == 10);
+        REQUIRE(storage.at<BarComp>(1).c == 'a');
+        REQUIRE(storage.at<BazComp>(2).s == "baz");
+        REQUIRE_THROWS(storage.at<BarComp>(0));
+
+        REQUIRE(storage.archetypeOf(0) != storage.archetypeOf(1));
+        REQUIRE(storage.archetypeOf(1)->m_signature == CEntitySignature::from<FooComp, BarComp>());
+    }
+
+    SECTION("Entities with the same signature share a table")
+    {
+        for(entityid_t id = 0; id < 10; id++)
+        {
+            storage.insert<BarComp>(id, {(char)id});
+            storage.insert<FooComp>(id, {(int)id});
+        }
+
+        REQUIRE(storage.archetypeCount() == 2);
+
+        const CArchetype *arch = storage.archetypeOf(0);
+        REQUIRE(arch->size() == 10);
+
+        for(entityid_t id = 0; id < 10; id++)
+        {
+            REQUIRE(storage.archetypeOf(id) == arch);
+            REQUIRE(arch->m_vecEntityIDs[storage.rowOf(id)] == id);
+            REQUIRE(arch->column<FooComp>()->m_data[storage.rowOf(id)].i == (int)id);
+        }
+    }
+
+    SECTION("Erasure")
+    {
+        for(entityid_t id = 0; id < 5; id++)
+        {
+            storage.insert<FooComp>(id, {(int)id});
+            storage.insert<BazComp>(id, {std::to_string(id)});
+        }
+
+        storage.erase<FooComp>(1);
+        storage.erase<BazComp>(3);
+        storage.eraseAll(4);
+        // erasing a component the entity doesn't have does nothing
+        storage.erase<BarComp>(0);
+        storage.erase<FooComp>(1);
+
+        REQUIRE(storage.size<FooComp>() == 3);
+        REQUIRE(storage.size<BazComp>() == 3);
+
+        REQUIRE_FALSE(storage.contains<FooComp>(1));
+        REQUIRE(storage.at<BazComp>(1).s == "1");
+        REQUIRE(storage.at<FooComp>(3).i == 3);
+        REQUIRE_FALSE(storage.contains<BazComp>(3));
+        REQUIRE(storage.archetypeOf(4) == nullptr);
+
+        // rows moved by swap-remove still point to the right owners
+        for(entityid_t id : {0, 2})
+        {
+            REQUIRE(storage.at<FooComp>(id).i == (int)id);
+            REQUIRE(storage.at<BazComp>(id).s == std::to_string(id));
+        }
+
+        storage.erase<FooComp>(3);
+        REQUIRE(storage.archetypeOf(3) == nullptr);
+    }
+
+    SECTION("Clear")
+    {
+        for(entityid_t id = 0; id < 6; id++)
+        {
+            storage.insert<FooComp>(id, {(int)id});
+            if(id % 2 == 0)
+            {
+                storage.insert<BarComp>(id, {(char)id});
+            }
+        }
+
+        storage.clear<FooComp>();
+
+        REQUIRE(storage.size<FooComp>() == 0);
+        REQUIRE(storage.size<BarComp>() == 3);
+        REQUIRE(storage.archetypeOf(1) == nullptr);
+        REQUIRE(storage.at<BarComp>(4).c == 4);
+    }
+
+    SECTION("Iterating matching archetypes")
+    {
+        for(entityid_t id = 0; id < 30; id++)
+        {
+            storage.insert<FooComp>(id, {(int)id});
+            if(id >= 10)
+            {
+                storage.insert<BarComp>(id, {(char)id});
+            }
+            if(id >= 20)
+            {
+                storage.insert<BazComp>(id, {"baz"});
+            }
+        }
+
+        int tables = 0;
+        int sum = 0;
+        storage.forEachMatchingArchetype(CEntitySignature::from<FooComp, BarComp>(), CEntitySignature::from<BazComp>(), 
+        [&](CArchetype& arch) {
+            tables++;
+            for(const FooComp& foo : arch.column<FooComp>()->m_data)
+            {
+                sum += foo.i;
+            }
+        });
+
+        REQUIRE(tables == 1);
+        // sum of 10..19
+        REQUIRE(sum == 145);
+    }
+}
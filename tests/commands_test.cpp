@@ -2,18 +2,43 @@
 
 #include "../include/chestnut/ecs/commands.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
 using namespace chestnut::ecs;
 using namespace chestnut::ecs::internal;
 
-struct Foo
+namespace
 {
-    int a;
-};
+    struct Foo
+    {
+        int a;
+    };
 
-struct Bar
-{
-    int a, b;
-};
+    struct Bar
+    {
+        int a, b;
+    };
+
+    // counts how many times any instance was copied or moved
+    struct Counted
+    {
+        inline static int copies = 0;
+        inline static int moves = 0;
+
+        int a;
+
+        Counted(int a = 0) : a(a) {}
+        Counted(const Counted& other) : a(other.a) { copies++; }
+        Counted(Counted&& other) noexcept : a(other.a) { moves++; }
+        Counted& operator=(const Counted& other) { a = other.a; copies++; return *this; }
+        Counted& operator=(Counted&& other) noexcept { a = other.a; moves++; return *this; }
+    };
+
+} // namespace
 
 TEST_CASE("Commands test")
 {
@@ -161,4 +186,372 @@ TEST_CASE("Commands test")
 
         REQUIRE(world.findEntities([](auto sign) { return true; }).size() == 0);
     }
+
+    SECTION("Many commands across blocks")
+    {
+        struct Big
+        {
+            char data[CCommandQueue::BLOCK_SIZE];
+        };
+
+        struct Items
+        {
+            std::vector<int> values;
+        };
+
+        for(int frame = 0; frame < 3; frame++)
+        {
+            std::vector<entityid_t> ents;
+            for(int i = 0; i < 2000; i++)
+            {
+                ents.push_back(world.createEntity());
+            }
+
+            for(int i = 0; i < 2000; i++)
+            {
+                // payload with heap memory, must survive staying in the queue
+                cmd.createOrUpdateComponent(ents[i], Items{ std::vector<int>(10, i) });
+            }
+            // larger than a whole block
+            cmd.createOrUpdateComponent(ents[0], Big{});
+            // executed in order, after the update above
+            cmd.updateComponent<Items>(ents[1], [](Items& items) { items.values.push_back(-1); });
+
+            REQUIRE_FALSE(cmd.getCommandQueue().empty());
+            cmd.getCommandQueue().execute(world);
+            REQUIRE(cmd.getCommandQueue().empty());
+
+            for(int i = 0; i < 2000; i++)
+            {
+                REQUIRE(world.getComponent<Items>(ents[i])->values[0] == i);
+            }
+            REQUIRE(world.getComponent<Items>(ents[1])->values.size() == 11);
+            REQUIRE(world.getComponent<Items>(ents[1])->values.back() == -1);
+            REQUIRE(world.hasComponent<Big>(ents[0]));
+
+            // executing again doesn't repeat commands
+            world.destroyEntity(ents[1]);
+            cmd.getCommandQueue().execute(world);
+            REQUIRE_FALSE(world.hasEntity(ents[1]));
+
+            world.destroyEntities(ents);
+        }
+    }
+
+    SECTION("Over-aligned commands")
+    {
+        struct Odd
+        {
+            char c[3];
+        };
+
+        struct alignas(16) Vec4
+        {
+            float v[4];
+        };
+
+        struct alignas(32) Simd
+        {
+            double v[4];
+        };
+
+        struct CAlignedCommand : public ICommand
+        {
+            alignas(32) double values[4];
+            int *misalignedCount;
+
+            CAlignedCommand(int *misalignedCount) 
+            : values{ 1.0, 2.0, 3.0, 4.0 }, misalignedCount(misalignedCount) 
+            {
+
+            }
+
+            void excecute(CEntityWorld& world) override
+            {
+                if(reinterpret_cast<uintptr_t>(this) % 32 != 0 || values[3] != 4.0)
+                {
+                    (*misalignedCount)++;
+                }
+            }
+        };
+
+        int misalignedCount = 0;
+        std::vector<entityid_t> ents;
+        for(int i = 0; i < 500; i++)
+        {
+            entityid_t ent = world.createEntity();
+            ents.push_back(ent);
+
+            // odd-sized records push the next ones off any larger alignment
+            cmd.createOrUpdateComponent(ent, Odd{ { (char)i, 0, 0 } })
+               .createOrUpdateComponent(ent, Vec4{ { (float)i, 0.0f, 0.0f, 1.0f } })
+               .createOrUpdateComponent(ent, Odd{ { (char)(i + 1), 0, 0 } })
+               .emplaceComponent<Simd>(ent, Simd{ { 0.0, 0.0, 0.0, (double)i } });
+            cmd.getCommandQueue().insert(CAlignedCommand(&misalignedCount));
+        }
+
+        cmd.getCommandQueue().execute(world);
+
+        REQUIRE(misalignedCount == 0);
+        for(int i = 0; i < 500; i++)
+        {
+            REQUIRE(world.getComponent<Odd>(ents[i])->c[0] == (char)(i + 1));
+            REQUIRE(world.getComponent<Vec4>(ents[i])->v[0] == (float)i);
+            REQUIRE(world.getComponent<Vec4>(ents[i])->v[3] == 1.0f);
+            REQUIRE(world.getComponent<Simd>(ents[i])->v[3] == (double)i);
+        }
+    }
+
+    SECTION("Parallel recording")
+    {
+        struct Log
+        {
+            std::vector<unsigned int> values;
+        };
+
+        CThreadPool pool(3);
+        CParallelCommands parallelCmd(pool);
+
+        entityid_t logEnt = world.createEntityWithComponents(Log{});
+        std::vector<entityid_t> ents;
+        for(int i = 0; i < 1000; i++)
+        {
+            ents.push_back(world.createEntity());
+        }
+
+        for(int run = 0; run < 2; run++)
+        {
+            pool.parallelFor(1000, [&](unsigned int taskIdx) {
+                parallelCmd.local()
+                    .sortKey(taskIdx)
+                    .createOrUpdateComponent(ents[taskIdx], Foo{(int)taskIdx})
+                    .updateComponent<Log>(logEnt, [taskIdx](Log& log) { log.values.push_back(taskIdx); });
+            });
+
+            // recorded outside of the pool, goes last thanks to its key
+            parallelCmd.local()
+                .sortKey(UINT64_MAX)
+                .updateComponent<Log>(logEnt, [](Log& log) { log.values.push_back(UINT32_MAX); });
+
+            parallelCmd.execute(world);
+
+            std::vector<unsigned int>& values = world.getComponent<Log>(logEnt)->values;
+            REQUIRE(values.size() == 1001);
+            for(unsigned int i = 0; i < 1000; i++)
+            {
+                REQUIRE(values[i] == i);
+                REQUIRE(world.getComponent<Foo>(ents[i])->a == (int)i);
+            }
+            REQUIRE(values.back() == UINT32_MAX);
+
+            values.clear();
+        }
+
+        parallelCmd.local().destroyEntity(logEnt);
+        parallelCmd.clear().execute(world);
+        REQUIRE(world.hasEntity(logEnt));
+    }
+
+    SECTION("Parallel recording with default sort keys")
+    {
+        struct Log
+        {
+            std::vector<std::pair<unsigned int, unsigned int>> slotAndSequence;
+        };
+
+        CThreadPool pool(3);
+        CParallelCommands parallelCmd(pool);
+
+        entityid_t logEnt = world.createEntityWithComponents(Log{});
+        entityid_t sharedEnt = world.createEntity();
+
+        for(int run = 0; run < 3; run++)
+        {
+            // each slot is used by one thread at a time, so it can count its own commands
+            std::vector<unsigned int> sequences(pool.getThreadSlotCount(), 0);
+
+            pool.parallelFor(300, [&](unsigned int taskIdx) {
+                const unsigned int slot = pool.currentThreadSlot();
+                const unsigned int seq = sequences[slot]++;
+
+                parallelCmd.local()
+                    .createOrUpdateComponent(sharedEnt, Foo{(int)(slot * 1000 + seq)})
+                    .updateComponent<Log>(logEnt, [slot, seq](Log& log) { log.slotAndSequence.emplace_back(slot, seq); });
+            });
+
+            parallelCmd.execute(world);
+
+            // ordered by thread slot, then by recording order
+            auto& log = world.getComponent<Log>(logEnt)->slotAndSequence;
+            REQUIRE(log.size() == 300);
+            REQUIRE(std::adjacent_find(log.begin(), log.end(), [](const auto& prev, const auto& next) { 
+                return prev >= next; 
+            }) == log.end());
+
+            // last command of the last slot wins
+            REQUIRE(world.getComponent<Foo>(sharedEnt)->a == (int)(log.back().first * 1000 + log.back().second));
+
+            log.clear();
+        }
+    }
+
+    SECTION("Runs of the same command are executed together")
+    {
+        CEntityQuery *qFoo = world.createQuery(makeEntitySignature<Foo>());
+        world.queryEntities(qFoo);
+
+        entityid_t ent1 = world.createEntity();
+        entityid_t ent2 = world.createEntityWithComponents(Foo{1});
+        entityid_t ent3 = world.createEntity();
+        entityid_t ent4 = world.createEntity();
+        world.destroyEntity(ent4);
+
+        for(int i = 0; i < 100; i++)
+        {
+            cmd.createEntity(Foo{i});
+        }
+        cmd.createUniqueEntity(Foo{100})
+           .createEntity(Foo{101})
+           // new component updated again in the same run
+           .createOrUpdateComponent(ent1, Foo{2})
+           .createOrUpdateComponent(ent2, Foo{3})
+           .createOrUpdateComponent(ent1, Foo{4})
+           .createOrUpdateComponent(ent4, Foo{5})
+           .destroyEntity(ent3)
+           .destroyEntity(ent2)
+           .destroyEntity(ent3)
+           .createOrUpdateComponent(ent3, Foo{6});
+
+        cmd.getCommandQueue().execute(world);
+
+        REQUIRE(world.getComponent<Foo>(ent1)->a == 4);
+        REQUIRE_FALSE(world.hasEntity(ent2));
+        REQUIRE_FALSE(world.hasEntity(ent3));
+        // the first new entity reused ent4 and was updated later
+        REQUIRE(world.hasEntity(ent4));
+        REQUIRE(world.getComponent<Foo>(ent4)->a == 5);
+
+        auto updateInfo = world.queryEntities(qFoo);
+        REQUIRE(updateInfo.added == 103);
+        // ent2 joined and left between updates
+        REQUIRE(updateInfo.removed == 0);
+        REQUIRE(updateInfo.total == 103);
+
+        int sum = 0;
+        qFoo->forEach<Foo>([&sum](Foo& foo) { sum += foo.a; });
+        REQUIRE(sum == (4950 - 0 + 5) + 100 + 101 + 4);
+
+        world.destroyQuery(qFoo);
+    }
+
+    SECTION("Reserved entities")
+    {
+        struct Parent
+        {
+            entityid_t ent;
+        };
+
+        CEntityQuery *qFoo = world.createQuery(makeEntitySignature<Foo>());
+        world.queryEntities(qFoo);
+
+        entityid_t parent = cmd.reserveEntity(world, Foo{1}, Bar{2, 3});
+        entityid_t child = cmd.reserveEntity(world);
+        cmd.createOrUpdateComponent(child, Parent{parent})
+           .createOrUpdateComponent(child, Foo{4});
+
+        REQUIRE(parent != child);
+        REQUIRE_FALSE(world.hasEntity(parent));
+
+        cmd.getCommandQueue().execute(world);
+
+        REQUIRE(world.getComponent<Foo>(parent)->a == 1);
+        REQUIRE(world.getComponent<Bar>(parent)->b == 3);
+        REQUIRE(world.getComponent<Parent>(child)->ent == parent);
+        REQUIRE(world.getComponent<Foo>(child)->a == 4);
+        REQUIRE(world.queryEntities(qFoo).added == 2);
+
+        // reserved from many threads
+        CThreadPool pool(3);
+        CParallelCommands parallelCmd(pool);
+        std::vector<entityid_t> spawned(1000);
+
+        pool.parallelFor(1000, [&](unsigned int i) {
+            spawned[i] = parallelCmd.local().sortKey(i).reserveEntity(world, Foo{(int)i});
+        });
+        parallelCmd.execute(world);
+
+        std::vector<entityid_t> sorted = spawned;
+        std::sort(sorted.begin(), sorted.end());
+        REQUIRE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+        for(unsigned int i = 0; i < 1000; i++)
+        {
+            REQUIRE(world.getComponent<Foo>(spawned[i])->a == (int)i);
+        }
+        REQUIRE(world.queryEntities(qFoo).added == 1000);
+
+        world.destroyQuery(qFoo);
+    }
+
+    SECTION("Components are not copied")
+    {
+        Counted::copies = 0;
+        Counted::moves = 0;
+
+        entityid_t ent1 = world.createEntity();
+        entityid_t ent2 = world.createEntity();
+
+        // constructed right in the queue and moved into storage once
+        cmd.emplaceComponent<Counted>(ent1, 1);
+        cmd.emplaceComponent<Bar>(ent1, 2, 3);
+        REQUIRE(Counted::moves == 0);
+        cmd.getCommandQueue().execute(world);
+        REQUIRE(Counted::moves == 1);
+        REQUIRE(world.getComponent<Counted>(ent1)->a == 1);
+        REQUIRE(world.getComponent<Bar>(ent1)->b == 3);
+
+        cmd.createEntity(Counted(4))
+           .createUniqueEntity(Counted(5), Foo{6})
+           .createOrUpdateComponent(ent2, Counted(7))
+           .createOrUpdateComponent(ent2, Counted(8))
+           .createOrUpdateComponent(ent1, Counted(9));
+        entityid_t ent3 = cmd.reserveEntity(world, Counted(10));
+        cmd.getCommandQueue().execute(world);
+
+        REQUIRE(Counted::copies == 0);
+        REQUIRE(world.getComponent<Counted>(ent1)->a == 9);
+        REQUIRE(world.getComponent<Counted>(ent2)->a == 8);
+        REQUIRE(world.getComponent<Counted>(ent3)->a == 10);
+        REQUIRE(world.findEntities([](auto sign) { return sign.has<Counted>(); }).size() == 5);
+
+        // lvalues get copied into the queue only once
+        Counted c(11);
+        cmd.createOrUpdateComponent(ent2, c)
+           .createEntity(c);
+        REQUIRE(Counted::copies == 2);
+        cmd.getCommandQueue().execute(world);
+        REQUIRE(Counted::copies == 2);
+        REQUIRE(world.getComponent<Counted>(ent2)->a == 11);
+    }
+
+    SECTION("Unexecuted commands are destroyed")
+    {
+        auto counter = std::make_shared<int>(0);
+
+        {
+            CCommands localCmd;
+            for(int i = 0; i < 1000; i++)
+            {
+                localCmd.updateComponent<Foo>(ENTITY_ID_INVALID, [counter](Foo&) {});
+            }
+            REQUIRE(counter.use_count() == 1001);
+
+            localCmd.clear();
+            REQUIRE(counter.use_count() == 1);
+
+            localCmd.updateComponent<Foo>(ENTITY_ID_INVALID, [counter](Foo&) {});
+            REQUIRE(counter.use_count() == 2);
+        }
+
+        REQUIRE(counter.use_count() == 1);
+    }
 }
\ No newline at end of file
@@ -5,21 +5,25 @@
 using namespace chestnut::ecs;
 using namespace chestnut::ecs::internal;
 
-struct FooComp
+namespace
 {
-    int i;
-};
+    struct FooComp
+    {
+        int i;
+    };
 
-struct BarComp
-{
-    char c;
-};
+    struct BarComp
+    {
+        char c;
+    };
 
-struct BazComp
-{
-    short s1;
-    short s2;
-};
+    struct BazComp
+    {
+        short s1;
+        short s2;
+    };
+
+} // namespace
 
 
 TEST_CASE( "Component storage test" )
@@ -146,4 +150,29 @@ TEST_CASE( "Component storage test" )
         auto sign3 = storage.signature(3);
         REQUIRE((sign3.has<BazComp>() && !sign3.has<FooComp, BarComp>()));
     }
-}
\ No newline at end of file
+
+    SECTION("Signature after erasure")
+    {
+        storage.insert<FooComp>(0, {0});
+        storage.insert<BarComp>(0, {0});
+        storage.insert<FooComp>(1, {1});
+        storage.insert<BazComp>(1, {1, 1});
+
+        storage.erase<FooComp>(0);
+        REQUIRE(storage.signature(0) == makeEntitySignature<BarComp>());
+
+        storage.erase<BarComp>(0);
+        REQUIRE(storage.signature(0).isEmpty());
+
+        storage.clear<BazComp>();
+        REQUIRE(storage.signature(1) == makeEntitySignature<FooComp>());
+
+        storage.insert<BarComp>(1);
+        REQUIRE(storage.signature(1) == makeEntitySignature<FooComp, BarComp>());
+
+        storage.eraseAll(1);
+        REQUIRE(storage.signature(1).isEmpty());
+        REQUIRE_FALSE(storage.contains<FooComp>(1));
+        REQUIRE_FALSE(storage.contains<BarComp>(1));
+    }
+}
@@ -0,0 +1,72 @@
+#include <catch2/catch.hpp>
+
+#include "../include/chestnut/ecs/component_type_family.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace chestnut::ecs;
+using namespace chestnut::ecs::internal;
+
+namespace
+{
+    struct FamilyFoo {};
+    struct FamilyBar {};
+    struct FamilyBaz {};
+
+} // namespace
+
+TEST_CASE("Component type family test")
+{
+    SECTION("IDs are stable and unique")
+    {
+        componenttypeid_t foo = CComponentTypeFamily::id<FamilyFoo>();
+        componenttypeid_t bar = CComponentTypeFamily::id<FamilyBar>();
+
+        REQUIRE(foo != COMPONENT_TYPE_ID_INVALID);
+        REQUIRE(bar != COMPONENT_TYPE_ID_INVALID);
+        REQUIRE(foo != bar);
+        REQUIRE(CComponentTypeFamily::id<FamilyFoo>() == foo);
+        REQUIRE(CComponentTypeFamily::id<const FamilyFoo>() == foo);
+        REQUIRE(CComponentTypeFamily::count() > foo);
+        REQUIRE(CComponentTypeFamily::count() > bar);
+    }
+
+    SECTION("Runtime type lookup")
+    {
+        componenttypeid_t foo = CComponentTypeFamily::id<FamilyFoo>();
+
+        REQUIRE(CComponentTypeFamily::id(typeid(FamilyFoo)) == foo);
+        REQUIRE(CComponentTypeFamily::find(typeid(FamilyFoo)) == foo);
+        REQUIRE(CComponentTypeFamily::type(foo) == std::type_index(typeid(FamilyFoo)));
+
+        REQUIRE(CComponentTypeFamily::find(typeid(FamilyBaz)) == COMPONENT_TYPE_ID_INVALID);
+    }
+
+    SECTION("Concurrent registration")
+    {
+        struct LocalA {};
+        struct LocalB {};
+
+        std::vector<componenttypeid_t> idsA(4), idsB(4);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&, i] {
+                idsA[i] = CComponentTypeFamily::id<LocalA>();
+                idsB[i] = CComponentTypeFamily::id(typeid(LocalB));
+            });
+        }
+        for(auto& t : threads)
+        {
+            t.join();
+        }
+
+        for (size_t i = 1; i < 4; i++)
+        {
+            REQUIRE(idsA[i] == idsA[0]);
+            REQUIRE(idsB[i] == idsB[0]);
+        }
+        REQUIRE(idsA[0] != idsB[0]);
+    }
+}
@@ -3,12 +3,19 @@
 #include "../include/chestnut/ecs/component_storage.hpp"
 #include "../include/chestnut/ecs/entity_registry.hpp"
 
+#include <algorithm>
+#include <thread>
+
 using namespace chestnut::ecs;
 using namespace chestnut::ecs::internal;
 
-struct FooComp {};
-struct BarComp {};
-struct BazComp {};
+namespace
+{
+    struct FooComp {};
+    struct BarComp {};
+    struct BazComp {};
+
+} // namespace
 
 TEST_CASE( "Entity registry test" )
 {
@@ -34,6 +41,35 @@ TEST_CASE( "Entity registry test" )
         REQUIRE_FALSE(registry.isEntityRegistered(ent3));
     }
 
+    SECTION("Check if registered after heavy recycling")
+    {
+        std::vector<entityid_t> ids;
+        for (size_t i = 0; i < 10000; i++)
+        {
+            ids.push_back(registry.registerNewEntity());
+        }
+        for (size_t i = 0; i < 10000; i += 2)
+        {
+            registry.unregisterEntity(ids[i]);
+        }
+
+        bool livenessCorrect = true;
+        for (size_t i = 0; i < 10000; i++)
+        {
+            livenessCorrect = livenessCorrect && registry.isEntityRegistered(ids[i]) == (i % 2 == 1);
+        }
+        REQUIRE(livenessCorrect);
+        REQUIRE_FALSE(registry.isEntityRegistered(ENTITY_ID_INVALID));
+        REQUIRE_FALSE(registry.isEntityRegistered(20000));
+
+        for (size_t i = 0; i < 5000; i++)
+        {
+            livenessCorrect = livenessCorrect && registry.isEntityRegistered(registry.registerNewEntity());
+        }
+        REQUIRE(livenessCorrect);
+        REQUIRE(registry.getEntityCount() == 10000);
+    }
+
     SECTION("ID recycling")
     {
         /*auto ent1 = */registry.registerNewEntity();
@@ -49,6 +85,121 @@ TEST_CASE( "Entity registry test" )
         REQUIRE(ent3 != ent5);
     }
 
+    SECTION("Reserving IDs")
+    {
+        std::vector<entityid_t> ids;
+        for (int i = 0; i < 10; i++)
+        {
+            ids.push_back(registry.registerNewEntity());
+        }
+        registry.unregisterEntity(ids[3]);
+        registry.unregisterEntity(ids[7]);
+
+        // recycled IDs first, then new ones
+        entityid_t res1 = registry.reserveEntity();
+        entityid_t res2 = registry.reserveEntity();
+        entityid_t res3 = registry.reserveEntity();
+        entityid_t res4 = registry.reserveEntity();
+        REQUIRE(res1 == ids[7]);
+        REQUIRE(res2 == ids[3]);
+        REQUIRE(res3 == 10);
+        REQUIRE(res4 == 11);
+        REQUIRE_FALSE(registry.isEntityRegistered(res1));
+        REQUIRE_FALSE(registry.isEntityRegistered(res3));
+
+        REQUIRE(registry.flushReservedEntities() == 4);
+        REQUIRE(registry.flushReservedEntities() == 0);
+        REQUIRE(registry.isEntityRegistered(res1));
+        REQUIRE(registry.isEntityRegistered(res2));
+        REQUIRE(registry.isEntityRegistered(res4));
+        REQUIRE(registry.getEntityCount() == 12);
+
+        // reservations are flushed before IDs are given out in other ways
+        registry.unregisterEntity(ids[0]);
+        entityid_t res5 = registry.reserveEntity();
+        entityid_t res6 = registry.reserveEntity();
+        entityid_t ent = registry.registerNewEntity();
+        REQUIRE(res5 == ids[0]);
+        REQUIRE(res6 == 12);
+        REQUIRE(ent == 13);
+        REQUIRE(registry.isEntityRegistered(res5));
+        REQUIRE(registry.isEntityRegistered(res6));
+    }
+
+    SECTION("Reserving IDs from many threads")
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            registry.registerNewEntity();
+        }
+        for (entityid_t id = 0; id < 1000; id += 2)
+        {
+            registry.unregisterEntity(id);
+        }
+
+        std::vector<std::vector<entityid_t>> reserved(4);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&registry, &reserved, t] {
+                for (int i = 0; i < 1000; i++)
+                {
+                    reserved[t].push_back(registry.reserveEntity());
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        registry.flushReservedEntities();
+
+        std::vector<entityid_t> all;
+        for (auto& ids : reserved)
+        {
+            all.insert(all.end(), ids.begin(), ids.end());
+        }
+        std::sort(all.begin(), all.end());
+
+        // every dead ID was reused and the rest are new, with no duplicates
+        REQUIRE(std::adjacent_find(all.begin(), all.end()) == all.end());
+        REQUIRE(all.size() == 4000);
+        REQUIRE(all.back() == 4499);
+        REQUIRE(registry.getEntityCount() == 4500);
+        for (entityid_t id : all)
+        {
+            REQUIRE(registry.isEntityRegistered(id));
+        }
+    }
+
+    SECTION("Entity handles")
+    {
+        auto ent1 = registry.registerNewEntity();
+        auto ent2 = registry.registerNewEntity();
+
+        SEntityHandle handle1 = registry.getEntityHandle(ent1);
+        SEntityHandle handle2 = registry.getEntityHandle(ent2);
+        REQUIRE(handle1.id == ent1);
+        REQUIRE(handle1 != handle2);
+        REQUIRE(registry.isEntityHandleValid(handle1));
+        REQUIRE(registry.isEntityHandleValid(handle2));
+        REQUIRE_FALSE(registry.isEntityHandleValid(ENTITY_HANDLE_INVALID));
+
+        registry.unregisterEntity(ent1);
+        REQUIRE_FALSE(registry.isEntityHandleValid(handle1));
+        REQUIRE(registry.getEntityHandle(ent1) == ENTITY_HANDLE_INVALID);
+
+        // same ID, different version
+        auto ent3 = registry.registerNewEntity(true);
+        REQUIRE(ent3 == ent1);
+        SEntityHandle handle3 = registry.getEntityHandle(ent3);
+        REQUIRE(handle3.id == handle1.id);
+        REQUIRE(handle3.version != handle1.version);
+        REQUIRE(registry.isEntityHandleValid(handle3));
+        REQUIRE_FALSE(registry.isEntityHandleValid(handle1));
+    }
+
     SECTION("Get signature")
     {
         auto ent1 = registry.registerNewEntity();
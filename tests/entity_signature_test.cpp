@@ -2,11 +2,18 @@
 
 #include "../include/chestnut/ecs/entity_signature.hpp"
 
+#include <algorithm>
+#include <vector>
+
 using namespace chestnut::ecs;
 
-struct Foo {};
-struct Bar {};
-struct Baz {};
+namespace
+{
+    struct Foo {};
+    struct Bar {};
+    struct Baz {};
+
+} // namespace
 
 TEST_CASE( "Entity signature test" )
 {
@@ -153,4 +160,42 @@ TEST_CASE( "Entity signature test" )
         REQUIRE(sign1 == sign1t2);
         REQUIRE(sign2 == sign2t2);
     }
-}
\ No newline at end of file
+
+    SECTION("Type IDs")
+    {
+        CEntitySignature sign;
+
+        componenttypeid_t fooId = internal::CComponentTypeFamily::id<Foo>();
+        componenttypeid_t bazId = internal::CComponentTypeFamily::id<Baz>();
+
+        sign.add(fooId);
+        sign.add(bazId);
+        REQUIRE(sign.has<Foo, Baz>());
+        REQUIRE(sign.has(fooId));
+        REQUIRE_FALSE(sign.has<Bar>());
+        REQUIRE_FALSE(sign.has(COMPONENT_TYPE_ID_INVALID));
+
+        std::vector<componenttypeid_t> ids;
+        sign.forEachType([&ids](componenttypeid_t id) {
+            ids.push_back(id);
+        });
+        REQUIRE(ids.size() == 2);
+        REQUIRE(ids[0] == std::min(fooId, bazId));
+        REQUIRE(ids[1] == std::max(fooId, bazId));
+
+        sign.remove(fooId);
+        REQUIRE_FALSE(sign.has<Foo>());
+        REQUIRE(sign.has<Baz>());
+
+        REQUIRE_THROWS(sign.add(MAX_COMPONENT_TYPES));
+    }
+
+    SECTION("Symmetric difference")
+    {
+        CEntitySignature sign1 = CEntitySignature::from<Foo, Bar>();
+        CEntitySignature sign2 = CEntitySignature::from<Bar, Baz>();
+
+        REQUIRE((sign1 ^ sign2) == CEntitySignature::from<Foo, Baz>());
+        REQUIRE((sign1 ^ sign1).isEmpty());
+    }
+}
@@ -2,33 +2,49 @@
 
 #include "../include/chestnut/ecs/entity_world.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 using namespace chestnut::ecs;
 using namespace chestnut::ecs::internal;
 
-class Foo
+namespace
 {
-public:
-    int x;
-};
+    class Foo
+    {
+    public:
+        int x;
+    };
 
-class Bar
-{
-public:
-    long y;
-};
+    class Bar
+    {
+    public:
+        long y;
+    };
 
-class Baz
-{
-public:
-    char z;
-    short w;
-};
+    class Baz
+    {
+    public:
+        char z;
+        short w;
+    };
+
+    struct Tag {};
+
+    struct Owned
+    {
+        std::unique_ptr<int> value;
+    };
+
+} // namespace
 
 
 
 TEST_CASE( "Entity world test - querying" )
 {
-    CEntityWorld world;
+    const EComponentStorageBackend backend = GENERATE(EComponentStorageBackend::SPARSE_SET, EComponentStorageBackend::ARCHETYPE);
+    CEntityWorld world(backend);
     std::vector<entityid_t> vEnts;
 
     // 10 entities with Foo
@@ -212,6 +228,690 @@ TEST_CASE( "Entity world test - querying" )
         REQUIRE(updateInfo.total == 5);
     }
 
+    SECTION( "Iterator after storage grows" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo, Bar>() );
+        world.queryEntities(q);
+
+        auto it = q->begin<Foo, Bar>();
+        auto end = q->end<Foo, Bar>();
+
+        // reallocates component arrays the iterator reads from
+        for (int i = 0; i < 1000; i++)
+        {
+            entityid_t ent = world.createEntity();
+            world.createComponent<Foo>( ent );
+            world.createComponent<Bar>( ent );
+        }
+
+        int count = 0;
+        for(; it != end; ++it)
+        {
+            auto [foo, bar] = *it;
+            REQUIRE( bar.y == foo.x + 1 );
+            count++;
+        }
+
+        REQUIRE( count == 20 );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Remove many entities from the query" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        REQUIRE( q->getEntityCount() == 40 );
+
+        // every other entity with Foo
+        for (int i = 0; i < 50; i += 2)
+        {
+            world.destroyEntity(vEnts[i]);
+        }
+
+        auto updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.removed == 20 );
+        REQUIRE( updateInfo.total == 20 );
+        REQUIRE( updateInfo.moved <= 20 );
+
+        auto ents = q->getEntities();
+        std::sort(ents.begin(), ents.end());
+        std::vector<entityid_t> expected;
+        for (int i = 1; i < 50; i += 2)
+        {
+            if(i < 20 || i >= 30)
+            {
+                expected.push_back(vEnts[i]);
+            }
+        }
+        REQUIRE( ents == expected );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Small changes don't reorder the whole query" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        entityid_t ent = world.createEntity();
+        world.createComponent<Foo>(ent)->x = 100;
+
+        auto updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.added == 1 );
+        REQUIRE( updateInfo.total == 41 );
+        REQUIRE( updateInfo.moved == 0 );
+
+        world.destroyEntity(vEnts[0]);
+
+        updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.removed == 1 );
+        REQUIRE( updateInfo.total == 40 );
+        REQUIRE( updateInfo.moved <= 1 );
+
+        int sum = 0;
+        q->forEach<Foo>([&sum](Foo& foo) {
+            sum += foo.x;
+        });
+        // 0..19 and 30..49 without the destroyed 0, plus the new 100
+        REQUIRE( sum == 190 + 790 + 100 );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Remove entities from a sorted query" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        q->sort<Foo>(std::function(
+            [](CEntityQuery::Iterator<Foo> it1, CEntityQuery::Iterator<Foo> it2) -> bool {
+                return it1.entityId() > it2.entityId();
+            }
+        ));
+
+        world.destroyEntity(vEnts[49]);
+        world.destroyComponent<Foo>(vEnts[5]);
+        world.destroyComponent<Foo>(vEnts[35]);
+
+        auto updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.removed == 3 );
+        REQUIRE( updateInfo.total == 37 );
+        // every entity after the first removed one shifts
+        REQUIRE( updateInfo.moved == 37 );
+
+        auto ents = q->getEntities();
+        REQUIRE( std::is_sorted(ents.rbegin(), ents.rend()) );
+        REQUIRE( std::find(ents.begin(), ents.end(), vEnts[5]) == ents.end() );
+        REQUIRE( std::find(ents.begin(), ents.end(), vEnts[35]) == ents.end() );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Entity leaving and coming back before update" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        world.destroyComponent<Foo>(vEnts[0]);
+        world.createComponent<Foo>(vEnts[0]);
+
+        auto updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.added == 0 );
+        REQUIRE( updateInfo.removed == 0 );
+        REQUIRE( q->getEntityCount() == 40 );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Many queries stay in sync with entity changes" )
+    {
+        std::vector<CEntityQuery *> queries {
+            world.createQuery( makeEntitySignature<Foo>() ),
+            world.createQuery( makeEntitySignature<Bar>(), makeEntitySignature<Foo>() ),
+            world.createQuery( makeEntitySignature<Foo, Bar, Baz>() ),
+            world.createQuery( makeEntitySignature<Baz>(), makeEntitySignature<Foo, Bar>() ),
+            world.createQuery( makeEntitySignature<>(), makeEntitySignature<Bar>() ),
+        };
+
+        world.destroyComponent<Foo>(vEnts[0]);
+        world.createComponent<Bar>(vEnts[1]);
+        world.createComponent<Baz>(vEnts[12]);
+        world.destroyComponent<Bar>(vEnts[25]);
+        world.destroyComponent<Baz>(vEnts[45]);
+        world.destroyEntity(vEnts[46]);
+        world.createEntityWithComponents(std::make_tuple(Foo{}, Baz{}));
+        world.createEntityWithComponents(Baz{});
+
+        for(CEntityQuery *q : queries)
+        {
+            world.queryEntities(q);
+
+            auto ents = q->getEntities();
+            std::sort(ents.begin(), ents.end());
+
+            auto expected = world.findEntities([q](const CEntitySignature& sign) {
+                return sign.hasAllFrom(q->getRequireSignature()) && !sign.hasAnyFrom(q->getRejectSignature());
+            });
+            std::sort(expected.begin(), expected.end());
+
+            REQUIRE( ents == expected );
+        }
+
+        world.destroyQuery(queries[0]);
+        world.createComponent<Bar>(vEnts[0]);
+        world.queryEntities(queries[1]);
+        REQUIRE( queries[1]->getEntityCount() == 10 );
+    }
+
+    SECTION( "New entities are added in storage order" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        std::vector<entityid_t> newEnts;
+        for (int i = 0; i < 100; i++)
+        {
+            newEnts.push_back(world.createEntity());
+        }
+        // give components in reverse, so that storage order differs from ID order
+        for (auto it = newEnts.rbegin(); it != newEnts.rend(); ++it)
+        {
+            world.createComponent<Foo>(*it);
+        }
+
+        auto updateInfo = world.queryEntities(q);
+        REQUIRE( updateInfo.added == 100 );
+
+        if(backend == EComponentStorageBackend::SPARSE_SET)
+        {
+            auto ents = q->getEntities();
+            REQUIRE( std::vector<entityid_t>(ents.begin() + 40, ents.end()) == std::vector<entityid_t>(newEnts.rbegin(), newEnts.rend()) );
+        }
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Entity changing its mind many times before update" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Bar>() );
+        world.queryEntities(q);
+
+        for (int i = 0; i < 5; i++)
+        {
+            world.destroyComponent<Bar>(vEnts[10]);
+            world.createComponent<Bar>(vEnts[10]);
+            world.createComponent<Bar>(vEnts[0]);
+            world.destroyComponent<Bar>(vEnts[0]);
+        }
+        world.destroyComponent<Bar>(vEnts[11]);
+        world.createComponent<Bar>(vEnts[1]);
+
+        auto updateInfo = world.queryEntities(q);
+
+        REQUIRE( updateInfo.added == 1 );
+        REQUIRE( updateInfo.removed == 1 );
+        REQUIRE( updateInfo.total == 30 );
+
+        auto ents = q->getEntities();
+        REQUIRE( std::count(ents.begin(), ents.end(), vEnts[10]) == 1 );
+        REQUIRE( std::count(ents.begin(), ents.end(), vEnts[0]) == 0 );
+        REQUIRE( std::count(ents.begin(), ents.end(), vEnts[1]) == 1 );
+        REQUIRE( std::count(ents.begin(), ents.end(), vEnts[11]) == 0 );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Batch structural changes" )
+    {
+        auto qFoo = world.createQuery( makeEntitySignature<Foo>() );
+        auto qBarNoFoo = world.createQuery( makeEntitySignature<Bar>(), makeEntitySignature<Foo>() );
+        world.queryEntities(qFoo);
+        world.queryEntities(qBarNoFoo);
+
+        std::vector<entityid_t> newEnts;
+        {
+            CEntityWorld::BatchScope batch(world);
+
+            for (int i = 0; i < 100; i++)
+            {
+                entityid_t ent = world.createEntity();
+                world.createComponent<Foo>(ent);
+                world.createComponent<Bar>(ent);
+                newEnts.push_back(ent);
+            }
+
+            // changed back and forth, queries shouldn't notice
+            world.destroyComponent<Foo>(vEnts[0]);
+            world.createComponent<Foo>(vEnts[0]);
+
+            world.destroyComponent<Foo>(vEnts[10]);
+            world.destroyEntity(vEnts[11]);
+
+            // nested batch doesn't flush anything
+            world.beginBatch();
+            world.destroyComponent<Foo>(newEnts[0]);
+            world.endBatch();
+
+            // queries don't know about changes until the batch ends
+            REQUIRE( world.queryEntities(qFoo).added == 0 );
+            REQUIRE( world.queryEntities(qBarNoFoo).added == 0 );
+        }
+
+        auto updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.added == 99 );
+        REQUIRE( updateInfo.removed == 2 );
+        REQUIRE( updateInfo.total == 137 );
+
+        updateInfo = world.queryEntities(qBarNoFoo);
+        REQUIRE( updateInfo.added == 2 );
+        REQUIRE( updateInfo.removed == 0 );
+        REQUIRE( updateInfo.total == 12 );
+
+        auto ents = qBarNoFoo->getEntities();
+        REQUIRE( std::count(ents.begin(), ents.end(), vEnts[10]) == 1 );
+        REQUIRE( std::count(ents.begin(), ents.end(), newEnts[0]) == 1 );
+
+        world.destroyQuery(qFoo);
+        world.destroyQuery(qBarNoFoo);
+    }
+
+    SECTION( "Batched entities are passed to queries in groups" )
+    {
+        auto qFoo = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(qFoo);
+
+        std::vector<entityid_t> newEnts;
+        {
+            CEntityWorld::BatchScope batch(world);
+
+            // entities of two different signatures interleaved
+            for (int i = 0; i < 100; i++)
+            {
+                entityid_t ent = world.createEntity();
+                world.createComponent<Foo>(ent)->x = 100 + i;
+                if(i % 2 == 1)
+                {
+                    world.createComponent<Baz>(ent);
+                }
+                newEnts.push_back(ent);
+            }
+
+            for (int i = 0; i < 5; i++)
+            {
+                world.destroyComponent<Foo>(vEnts[i]);
+                world.destroyEntity(vEnts[10 + i]);
+            }
+        }
+
+        // all changes come in a single update
+        auto updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.added == 100 );
+        REQUIRE( updateInfo.removed == 10 );
+        REQUIRE( updateInfo.total == 130 );
+
+        updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.added == 0 );
+        REQUIRE( updateInfo.removed == 0 );
+
+        auto ents = qFoo->getEntities();
+        for (entityid_t ent : newEnts)
+        {
+            REQUIRE( std::count(ents.begin(), ents.end(), ent) == 1 );
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            REQUIRE( std::count(ents.begin(), ents.end(), vEnts[i]) == 0 );
+            REQUIRE( std::count(ents.begin(), ents.end(), vEnts[10 + i]) == 0 );
+        }
+
+        world.destroyQuery(qFoo);
+    }
+
+    SECTION( "Reusing ID of an entity destroyed during a batch" )
+    {
+        // doesn't require anything, so destroying any entity without Bar affects it
+        auto qNoBar = world.createQuery( CEntitySignature(), makeEntitySignature<Bar>() );
+        auto qBaz = world.createQuery( makeEntitySignature<Baz>() );
+        world.queryEntities(qNoBar);
+        world.queryEntities(qBaz);
+
+        auto contains = [](CEntityQuery *q, entityid_t ent) {
+            auto ents = q->getEntities();
+            return std::count(ents.begin(), ents.end(), ent) == 1;
+        };
+
+        // the same happens with and without a batch
+        for (int batched = 0; batched < 2; batched++)
+        {
+            const entityid_t emptyEnt = vEnts[batched * 2];
+            const entityid_t bazEnt = vEnts[batched * 2 + 1];
+            REQUIRE( contains(qNoBar, emptyEnt) );
+            REQUIRE( contains(qNoBar, bazEnt) );
+
+            if(batched)
+            {
+                world.beginBatch();
+            }
+
+            world.destroyEntity(emptyEnt);
+            REQUIRE( world.createEntity() == emptyEnt );
+
+            world.destroyEntity(bazEnt);
+            REQUIRE( world.createEntity() == bazEnt );
+            world.createComponent<Baz>(bazEnt);
+
+            if(batched)
+            {
+                world.endBatch();
+            }
+
+            auto updateInfo = world.queryEntities(qNoBar);
+            REQUIRE( updateInfo.removed == 2 );
+            REQUIRE( updateInfo.added == 0 );
+            REQUIRE_FALSE( contains(qNoBar, emptyEnt) );
+            REQUIRE_FALSE( contains(qNoBar, bazEnt) );
+
+            REQUIRE( world.queryEntities(qBaz).added == 1 );
+            REQUIRE( contains(qBaz, bazEnt) );
+        }
+
+        world.destroyQuery(qNoBar);
+        world.destroyQuery(qBaz);
+    }
+
+    SECTION( "Iterating queries during a batch" )
+    {
+        auto qFoo = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(qFoo);
+
+        auto countAndSum = [qFoo]() {
+            int count = 0, sum = 0;
+            qFoo->forEach<Foo>([&count, &sum](Foo& foo) {
+                count++;
+                sum += foo.x;
+            });
+            return std::make_pair(count, sum);
+        };
+
+        const auto before = countAndSum();
+        REQUIRE( before.first == 40 );
+
+        {
+            CEntityWorld::BatchScope batch(world);
+
+            for (int i = 0; i < 10; i++)
+            {
+                entityid_t ent = world.createEntity();
+                world.createComponent<Foo>(ent)->x = 1000;
+            }
+            // moved to other archetypes, but still in the query
+            world.createComponent<Baz>(vEnts[1]);
+            world.createComponent<Tag>(vEnts[12]);
+            // joins the query
+            world.createComponent<Foo>(vEnts[20])->x = 1000;
+
+            // both backends see only entities the query has been given
+            REQUIRE( countAndSum() == before );
+
+            std::atomic<int> parallelCount = 0;
+            qFoo->parallelForEach<Foo>([&parallelCount](Foo& foo) {
+                parallelCount++;
+            }, 4);
+            REQUIRE( parallelCount == 40 );
+
+            unsigned int chunkCount = 0;
+            qFoo->forEachChunk<Foo>([&chunkCount](CEntityQuery::Chunk<Foo> chunk) {
+                chunkCount += chunk.count;
+            });
+            REQUIRE( chunkCount == 40 );
+
+            // updating in the middle of the batch doesn't change that
+            REQUIRE( world.queryEntities(qFoo).added == 0 );
+            REQUIRE( countAndSum() == before );
+        }
+
+        REQUIRE( world.queryEntities(qFoo).added == 11 );
+        const auto after = countAndSum();
+        REQUIRE( after.first == 51 );
+        REQUIRE( after.second == before.second + 11 * 1000 );
+
+        world.destroyQuery(qFoo);
+    }
+
+    SECTION( "Bulk creation" )
+    {
+        auto qFoo = world.createQuery( makeEntitySignature<Foo>() );
+        auto qFooBar = world.createQuery( makeEntitySignature<Foo, Bar>() );
+        auto qBazNoFoo = world.createQuery( makeEntitySignature<Baz>(), makeEntitySignature<Foo>() );
+        world.queryEntities(qFoo);
+        world.queryEntities(qFooBar);
+        world.queryEntities(qBazNoFoo);
+
+        auto newEnts = world.createEntitiesWithComponents<Foo, Bar>(100, [](entitysize_t i) {
+            return std::make_tuple(Foo{(int)i}, Bar{(long)i * 2});
+        });
+        REQUIRE( newEnts.size() == 100 );
+
+        auto updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.added == 100 );
+        REQUIRE( updateInfo.total == 140 );
+        updateInfo = world.queryEntities(qFooBar);
+        REQUIRE( updateInfo.added == 100 );
+        REQUIRE( updateInfo.total == 120 );
+
+        for (entitysize_t i = 0; i < 100; i++)
+        {
+            REQUIRE( world.getComponent<Foo>(newEnts[i])->x == (int)i );
+            REQUIRE( world.getComponent<Bar>(newEnts[i])->y == (long)i * 2 );
+        }
+
+        // Baz to entities with Foo, with Bar and Baz, to a dead one and to a brand new one
+        world.destroyEntity(vEnts[0]);
+        std::vector<entityid_t> bazEnts { vEnts[0], vEnts[1], vEnts[20], newEnts[5], newEnts[6] };
+        world.createEntities(2, bazEnts);
+        REQUIRE( bazEnts.size() == 7 );
+        REQUIRE( bazEnts[5] == vEnts[0] ); // recycled
+
+        std::vector<Baz> bazs;
+        for (int i = 0; i < 7; i++)
+        {
+            bazs.push_back(Baz{(char)i, (short)i});
+        }
+
+        // vEnts[20] already has Baz
+        REQUIRE( world.createComponents(bazEnts, std::move(bazs)) == 5 );
+        REQUIRE( world.getComponent<Baz>(vEnts[20])->z == 21 );
+        REQUIRE( world.getComponent<Baz>(newEnts[6])->z == 4 );
+        REQUIRE( world.getComponent<Baz>(bazEnts[6])->w == 6 );
+
+        updateInfo = world.queryEntities(qBazNoFoo);
+        REQUIRE( updateInfo.added == 2 );
+        REQUIRE( updateInfo.total == 12 );
+        updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.added == 0 );
+        REQUIRE( updateInfo.removed == 1 ); // destroyed vEnts[0]
+
+        // single type generator can return the component directly
+        auto fooEnts = world.createEntitiesWithComponents<Foo>(10, [](entitysize_t i) { return Foo{(int)i + 1000}; });
+        REQUIRE( world.queryEntities(qFoo).added == 10 );
+        REQUIRE( world.getComponent<Foo>(fooEnts[9])->x == 1009 );
+
+        // components can also be moved from objects kept elsewhere
+        Bar bar1 {2000}, bar2 {2001}, bar3 {2002};
+        std::vector<Bar *> barPtrs { &bar1, &bar2, &bar3 };
+        std::vector<entityid_t> barEnts { fooEnts[0], newEnts[0], fooEnts[1] };
+        REQUIRE( world.createComponents(barEnts, barPtrs.data()) == 2 ); // newEnts[0] already has Bar
+        REQUIRE( world.getComponent<Bar>(fooEnts[0])->y == 2000 );
+        REQUIRE( world.getComponent<Bar>(newEnts[0])->y == 0 );
+        REQUIRE( world.getComponent<Bar>(fooEnts[1])->y == 2002 );
+        REQUIRE( world.queryEntities(qFooBar).added == 2 );
+
+        world.destroyQuery(qFoo);
+        world.destroyQuery(qFooBar);
+        world.destroyQuery(qBazNoFoo);
+    }
+
+    SECTION( "Bulk destruction" )
+    {
+        auto qFoo = world.createQuery( makeEntitySignature<Foo>() );
+        auto qBar = world.createQuery( makeEntitySignature<Bar>() );
+        auto qBazNoFoo = world.createQuery( makeEntitySignature<Baz>(), makeEntitySignature<Foo>() );
+        world.queryEntities(qFoo);
+        world.queryEntities(qBar);
+        world.queryEntities(qBazNoFoo);
+
+        entityid_t empty = world.createEntity();
+        entityid_t dead = world.createEntity();
+        world.destroyEntity(dead);
+
+        // every other entity with Foo and Bar, one with Bar and Baz, duplicates and non-existing ones
+        std::vector<entityid_t> toDestroy;
+        for (int i = 10; i < 20; i += 2)
+        {
+            toDestroy.push_back(vEnts[i]);
+        }
+        toDestroy.push_back(vEnts[25]);
+        toDestroy.push_back(vEnts[10]);
+        toDestroy.push_back(empty);
+        toDestroy.push_back(dead);
+
+        world.destroyEntities(toDestroy);
+
+        REQUIRE_FALSE( world.hasEntity(vEnts[10]) );
+        REQUIRE_FALSE( world.hasEntity(vEnts[25]) );
+        REQUIRE_FALSE( world.hasEntity(empty) );
+        REQUIRE( world.hasEntity(vEnts[11]) );
+        REQUIRE( world.getComponent<Foo>(vEnts[11])->x == 11 );
+        REQUIRE( world.getComponent<Bar>(vEnts[11])->y == 12 );
+        REQUIRE( world.getComponent<Baz>(vEnts[24])->z == 25 );
+
+        auto updateInfo = world.queryEntities(qFoo);
+        REQUIRE( updateInfo.removed == 5 );
+        REQUIRE( updateInfo.total == 35 );
+        updateInfo = world.queryEntities(qBar);
+        REQUIRE( updateInfo.removed == 6 );
+        REQUIRE( updateInfo.total == 24 );
+        updateInfo = world.queryEntities(qBazNoFoo);
+        REQUIRE( updateInfo.removed == 1 );
+        REQUIRE( updateInfo.total == 9 );
+
+        // entities that joined the query since its last update are destroyed too
+        entityid_t late = world.createEntityWithComponents(Baz{1, 2});
+        world.destroyEntities(qBazNoFoo);
+
+        REQUIRE_FALSE( world.hasEntity(late) );
+        REQUIRE_FALSE( world.hasEntity(vEnts[20]) );
+        REQUIRE( world.queryEntities(qBazNoFoo).total == 0 );
+        updateInfo = world.queryEntities(qBar);
+        REQUIRE( updateInfo.removed == 9 );
+        REQUIRE( updateInfo.total == 15 );
+        REQUIRE( world.queryEntities(qFoo).total == 35 );
+
+        int xSum = 0;
+        qFoo->forEach<Foo>([&xSum](Foo& foo) { xSum += foo.x; });
+        REQUIRE( xSum == 45 + (11 + 13 + 15 + 17 + 19) + (30 + 39) * 5 + (40 + 49) * 5 );
+
+        world.destroyQuery(qFoo);
+        world.destroyQuery(qBar);
+        world.destroyQuery(qBazNoFoo);
+    }
+
+    SECTION( "Many components in a single change" )
+    {
+        auto qFooBarBaz = world.createQuery( makeEntitySignature<Foo, Bar, Baz>() );
+        auto qBarNoFoo = world.createQuery( makeEntitySignature<Bar>(), makeEntitySignature<Foo>() );
+        world.queryEntities(qFooBarBaz);
+        world.queryEntities(qBarNoFoo);
+
+        // Foo only -> Foo, Bar, Baz
+        REQUIRE( world.createComponents(vEnts[0], Bar{100}, Baz{1, 2}) );
+        // Bar and Baz -> Foo, Bar, Baz; existing Bar is kept
+        const Foo foo{200};
+        REQUIRE( world.createComponents(vEnts[20], foo, Bar{300}) );
+        // nothing new
+        REQUIRE( world.createComponents(vEnts[40], Foo{400}) );
+
+        REQUIRE_FALSE( world.createComponents(ENTITY_ID_INVALID, Foo{0}) );
+
+        REQUIRE( world.getEntitySignature(vEnts[0]) == makeEntitySignature<Foo, Bar, Baz>() );
+        REQUIRE( world.getComponent<Bar>(vEnts[0])->y == 100 );
+        REQUIRE( world.getComponent<Baz>(vEnts[0])->w == 2 );
+        REQUIRE( world.getComponent<Foo>(vEnts[20])->x == 200 );
+        REQUIRE( world.getComponent<Bar>(vEnts[20])->y == 20 );
+        REQUIRE( world.getComponent<Foo>(vEnts[40])->x == 40 );
+
+        auto updateInfo = world.queryEntities(qFooBarBaz);
+        REQUIRE( updateInfo.added == 2 );
+        REQUIRE( updateInfo.total == 12 );
+        updateInfo = world.queryEntities(qBarNoFoo);
+        REQUIRE( updateInfo.removed == 1 );
+        REQUIRE( updateInfo.total == 9 );
+
+        // Foo, Bar, Baz -> Bar
+        world.destroyComponents<Foo, Baz>(vEnts[41]);
+        // Foo, Bar, Baz -> nothing
+        world.destroyComponents<Baz, Bar, Foo>(vEnts[42]);
+        // Foo and Bar -> nothing, Baz wasn't there
+        world.destroyComponents<Foo, Bar, Baz>(vEnts[10]);
+
+        REQUIRE( world.getEntitySignature(vEnts[41]) == makeEntitySignature<Bar>() );
+        REQUIRE( world.getComponent<Bar>(vEnts[41])->y == 42 );
+        REQUIRE( world.getEntitySignature(vEnts[42]).isEmpty() );
+        REQUIRE( world.getEntitySignature(vEnts[10]).isEmpty() );
+        REQUIRE( world.hasEntity(vEnts[42]) );
+
+        updateInfo = world.queryEntities(qFooBarBaz);
+        REQUIRE( updateInfo.removed == 2 );
+        REQUIRE( updateInfo.total == 10 );
+        updateInfo = world.queryEntities(qBarNoFoo);
+        REQUIRE( updateInfo.added == 1 );
+        REQUIRE( updateInfo.total == 10 );
+
+        world.destroyQuery(qFooBarBaz);
+        world.destroyQuery(qBarNoFoo);
+    }
+
+    SECTION( "Query with tag components" )
+    {
+        for (int i = 0; i < 50; i += 3)
+        {
+            world.createComponent<Tag>(vEnts[i]);
+        }
+
+        auto qFooTag = world.createQuery( makeEntitySignature<Foo, Tag>() );
+        world.queryEntities(qFooTag);
+        REQUIRE( qFooTag->getEntityCount() == 14 );
+
+        int sum = 0;
+        qFooTag->forEach<Foo, Tag>([&sum](Foo& foo, Tag&) { sum += foo.x; });
+        int chunkSum = 0;
+        qFooTag->forEachChunk<Tag, Foo>([&chunkSum](CEntityQuery::Chunk<Tag, Foo> chunk) {
+            for (unsigned int i = 0; i < chunk.count; i++)
+            {
+                chunkSum += chunk.get<Foo>()[i].x;
+            }
+        }, 4);
+
+        // multiples of 3 below 50, except the ones in 20-29 without Foo
+        REQUIRE( sum == 408 - (21 + 24 + 27) );
+        REQUIRE( chunkSum == sum );
+
+        world.destroyComponent<Tag>(vEnts[0]);
+        world.destroyComponent<Tag>(vEnts[3]);
+        REQUIRE( world.queryEntities(qFooTag).removed == 2 );
+        REQUIRE_FALSE( world.hasComponent<Tag>(vEnts[0]) );
+        REQUIRE( world.hasComponent<Tag>(vEnts[6]) );
+
+        world.destroyQuery(qFooTag);
+    }
+
     SECTION( "Query non-existing entities" )
     {
         auto q = world.createQuery( makeEntitySignature<Bar>(), makeEntitySignature<Foo, Baz>() );
@@ -236,9 +936,204 @@ TEST_CASE( "Entity world test - querying" )
             }
         ));
 
+        int count = 0;
+        q->forEach<Bar>([&count](Bar& bar) {
+            bar.y = -bar.y;
+            count++;
+        });
+        REQUIRE( count == 30 );
+        REQUIRE( world.getComponent<Bar>(vEnts[10])->y == -11 );
+
+        REQUIRE_THROWS_AS(q->forEach<Foo>([](Foo& foo) {}), QueryException);
+
         world.destroyQuery(q); 
     }
 
+    SECTION( "Use forEach after structural changes" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo, Baz>() );
+        world.queryEntities(q);
+
+        REQUIRE( q->getEntityCount() == 20 );
+
+        // moves entity to another table, but it still fits the query
+        world.createComponent<Bar>(vEnts[30]);
+        // new entity fits the query, but the query wasn't updated yet
+        entityid_t ent = world.createEntity();
+        world.createComponent<Foo>(ent)->x = 50;
+        world.createComponent<Baz>(ent);
+
+        int count = 0;
+        q->forEach<Foo, Baz>([&count](Foo& foo, Baz& baz) {
+            count++;
+        });
+        REQUIRE( count == 20 );
+
+        world.queryEntities(q);
+
+        count = 0;
+        int sum = 0;
+        q->forEach<Foo, Baz>([&](Foo& foo, Baz& baz) {
+            count++;
+            sum += foo.x;
+            foo.x = -1;
+        });
+        REQUIRE( count == 21 );
+        // sum of 30..50
+        REQUIRE( sum == 840 );
+        REQUIRE( world.getComponent<Foo>(vEnts[30])->x == -1 );
+        REQUIRE( world.getComponent<Foo>(vEnts[45])->x == -1 );
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Use parallelForEach" )
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            entityid_t ent = world.createEntity();
+            world.createComponent<Foo>( ent )->x = i;
+            world.createComponent<Bar>( ent )->y = 0;
+        }
+
+        auto q = world.createQuery( makeEntitySignature<Foo, Bar>() );
+        world.queryEntities(q);
+
+        REQUIRE( q->getEntityCount() == 10020 );
+
+        CThreadPool pool(4);
+        std::atomic<int> count = 0;
+        q->parallelForEach<Foo, Bar>([&count](Foo& foo, Bar& bar) {
+            bar.y = foo.x * 2;
+            count++;
+        }, 100, pool);
+
+        REQUIRE( count == 10020 );
+
+        bool allUpdated = true;
+        q->forEach<Foo, Bar>([&allUpdated](Foo& foo, Bar& bar) {
+            allUpdated = allUpdated && bar.y == foo.x * 2;
+        });
+        REQUIRE( allUpdated );
+
+        REQUIRE_THROWS_AS(q->parallelForEach<Baz>([](Baz& baz) {}), QueryException);
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Use forEachChunk" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo, Bar>() );
+        world.queryEntities(q);
+
+        unsigned int total = 0;
+        unsigned int chunks = 0;
+        q->forEachChunk<Foo, Bar>([&](CEntityQuery::Chunk<Foo, Bar> chunk) {
+            REQUIRE( chunk.count <= 4 );
+
+            Foo *foos = chunk.get<Foo>();
+            Bar *bars = chunk.get<Bar>();
+            for(unsigned int i = 0; i < chunk.count; i++)
+            {
+                REQUIRE( bars[i].y == foos[i].x + 1 );
+                REQUIRE( world.getComponent<Foo>(chunk.entityIds[i])->x == foos[i].x );
+                foos[i].x = -foos[i].x;
+            }
+
+            total += chunk.count;
+            chunks++;
+        }, 4);
+
+        REQUIRE( total == 20 );
+        REQUIRE( chunks >= 5 );
+
+        // changes made to gathered components are written back
+        for (int i = 10; i < 20; i++)
+        {
+            REQUIRE( world.getComponent<Foo>(vEnts[i])->x == -i );
+        }
+        for (int i = 40; i < 50; i++)
+        {
+            REQUIRE( world.getComponent<Foo>(vEnts[i])->x == -i );
+        }
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Use forEachChunk with move-only components" )
+    {
+        // given out in reverse, so chunks of the query have to be gathered
+        for (int i = 49; i >= 0; i--)
+        {
+            if(world.hasComponent<Foo>(vEnts[i]))
+            {
+                world.createComponent<Owned>(vEnts[i])->value = std::make_unique<int>(i);
+            }
+        }
+
+        auto q = world.createQuery( makeEntitySignature<Foo, Owned>() );
+        world.queryEntities(q);
+
+        q->sort<Foo>(std::function(
+            [](CEntityQuery::Iterator<Foo> it1, CEntityQuery::Iterator<Foo> it2) -> bool {
+                return it1.entityId() < it2.entityId();
+            }
+        ));
+
+        unsigned int total = 0;
+        q->forEachChunk<Foo, Owned>([&](CEntityQuery::Chunk<Foo, Owned> chunk) {
+            Foo *foos = chunk.get<Foo>();
+            Owned *owneds = chunk.get<Owned>();
+            for(unsigned int i = 0; i < chunk.count; i++)
+            {
+                REQUIRE( owneds[i].value );
+                REQUIRE( *owneds[i].value == foos[i].x );
+                *owneds[i].value *= 2;
+            }
+
+            total += chunk.count;
+        }, 8);
+
+        REQUIRE( total == 40 );
+
+        // components are moved back into storage after each chunk
+        for (int i = 0; i < 50; i++)
+        {
+            if(world.hasComponent<Owned>(vEnts[i]))
+            {
+                REQUIRE( world.getComponent<Owned>(vEnts[i])->value );
+                REQUIRE( *world.getComponent<Owned>(vEnts[i])->value == 2 * i );
+            }
+        }
+
+        world.destroyQuery(q);
+    }
+
+    SECTION( "Use forEachChunk with contiguous storage" )
+    {
+        auto q = world.createQuery( makeEntitySignature<Foo>() );
+        world.queryEntities(q);
+
+        // entities were given Foo in ascending ID order
+        q->sort<Foo>(std::function(
+            [](CEntityQuery::Iterator<Foo> it1, CEntityQuery::Iterator<Foo> it2) -> bool {
+                return it1.entityId() < it2.entityId();
+            }
+        ));
+
+        bool isDirect = true;
+        q->forEachChunk<Foo>([&](CEntityQuery::Chunk<Foo> chunk) {
+            isDirect = isDirect && chunk.get<Foo>() == &world.getComponent<Foo>(chunk.entityIds[0]).get();
+        }, 8);
+
+        if(backend == EComponentStorageBackend::SPARSE_SET)
+        {
+            REQUIRE( isDirect );
+        }
+
+        world.destroyQuery(q);
+    }
+
     SECTION( "Sort the query" ) 
     {
         auto q = world.createQuery( makeEntitySignature<Foo>() );
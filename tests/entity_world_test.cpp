@@ -5,24 +5,28 @@
 
 using namespace chestnut::ecs;
 
-class Foo
+namespace
 {
-public:
-    int x;
-};
+    class Foo
+    {
+    public:
+        int x;
+    };
 
-class Bar
-{
-public:
-    long y;
-};
+    class Bar
+    {
+    public:
+        long y;
+    };
 
-class Baz
-{
-public:
-    char z;
-    short w;
-};
+    class Baz
+    {
+    public:
+        char z;
+        short w;
+    };
+
+} // namespace
 
 
 TEST_CASE( "Entity world test - general" )
@@ -80,6 +84,31 @@ TEST_CASE( "Entity world test - general" )
     }
 
 
+    SECTION( "Entity handles" )
+    {
+        entityid_t ent1 = world.createEntityWithComponents(Foo{1});
+        SEntityHandle handle1 = world.getEntityHandle(ent1);
+
+        REQUIRE( world.hasEntity(handle1) );
+        REQUIRE( world.hasComponent<Foo>(handle1) );
+        REQUIRE( world.getComponent<Foo>(handle1)->x == 1 );
+
+        world.destroyEntity(handle1);
+        REQUIRE_FALSE( world.hasEntity(ent1) );
+        REQUIRE_FALSE( world.hasEntity(handle1) );
+
+        // ID gets recycled, but the old handle stays stale
+        entityid_t ent2 = world.createEntityWithComponents(Foo{2});
+        REQUIRE( ent2 == ent1 );
+        REQUIRE_FALSE( world.hasEntity(handle1) );
+        REQUIRE_FALSE( world.hasComponent<Foo>(handle1) );
+        REQUIRE_FALSE( world.getComponent<Foo>(handle1) );
+
+        world.destroyEntity(handle1);
+        REQUIRE( world.hasEntity(ent2) );
+        REQUIRE( world.getComponent<Foo>(world.getEntityHandle(ent2))->x == 2 );
+    }
+
     SECTION( "Creating components" )
     {
         // try create component for nonexistant entity
@@ -527,4 +556,15 @@ TEST_CASE( "Entity world test - benchmarks", "[benchmark]" )
 
         return foo->x; //returning something because catch2 wants it
     };
+
+    BENCHMARK( "Creating and destroying a lot of entities in bulk" )
+    {
+        auto ents = world.createEntitiesWithComponents<Foo, Bar, Baz>(ENTITY_COUNT, [](entitysize_t i) {
+            return std::make_tuple(Foo{(int)i}, Bar{2137}, Baz{123, 0});
+        });
+
+        world.destroyEntities(ents);
+
+        return ents.size();
+    };
 }
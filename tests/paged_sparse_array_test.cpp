@@ -0,0 +1,116 @@
+#include <catch2/catch.hpp>
+
+#include "../include/chestnut/ecs/paged_sparse_array.hpp"
+
+
+using namespace chestnut::ecs::internal;
+
+TEST_CASE("Paged sparse array test")
+{
+    const auto PAGE_SIZE = CPagedSparseArray::PAGE_SIZE;
+    const auto NIL_INDEX = CPagedSparseArray::NIL_INDEX;
+
+    SECTION("Initial state")
+    {
+        CPagedSparseArray arr(10);
+
+        REQUIRE(arr.size() == 10);
+        REQUIRE(arr.allocatedPageCount() == 0);
+        REQUIRE(arr[0] == NIL_INDEX);
+        REQUIRE(arr[9] == NIL_INDEX);
+        REQUIRE(arr[100 * PAGE_SIZE] == NIL_INDEX);
+    }
+
+    SECTION("Pages are allocated on demand")
+    {
+        CPagedSparseArray arr;
+
+        arr.set(1, 1);
+        arr.set(2, 2);
+        arr.set(10 * PAGE_SIZE + 3, 3);
+
+        REQUIRE(arr.size() == 10 * PAGE_SIZE + 4);
+        REQUIRE(arr.allocatedPageCount() == 2);
+        REQUIRE(arr[1] == 1);
+        REQUIRE(arr[2] == 2);
+        REQUIRE(arr[10 * PAGE_SIZE + 3] == 3);
+        REQUIRE(arr[5 * PAGE_SIZE] == NIL_INDEX);
+
+        // writing NIL into an unused range doesn't allocate
+        arr.set(5 * PAGE_SIZE, NIL_INDEX);
+        REQUIRE(arr.allocatedPageCount() == 2);
+
+        // nor does it grow the array
+        arr.set(100 * PAGE_SIZE, NIL_INDEX);
+        REQUIRE(arr.size() == 10 * PAGE_SIZE + 4);
+        REQUIRE(arr[100 * PAGE_SIZE] == NIL_INDEX);
+    }
+
+    SECTION("Emptied pages are kept until reset")
+    {
+        CPagedSparseArray arr;
+
+        arr.set(PAGE_SIZE + 1, 1);
+        arr.set(PAGE_SIZE + 2, 2);
+        REQUIRE(arr.allocatedPageCount() == 1);
+
+        arr.set(PAGE_SIZE + 1, NIL_INDEX);
+        REQUIRE(arr.allocatedPageCount() == 1);
+        REQUIRE(arr[PAGE_SIZE + 2] == 2);
+
+        // toggling the only entry of a page doesn't release and allocate it again
+        for(int i = 0; i < 10; i++)
+        {
+            arr.set(PAGE_SIZE + 2, NIL_INDEX);
+            REQUIRE(arr.allocatedPageCount() == 1);
+            REQUIRE(arr[PAGE_SIZE + 2] == NIL_INDEX);
+            REQUIRE(arr[PAGE_SIZE + 1] == NIL_INDEX);
+
+            arr.set(PAGE_SIZE + 2, i);
+            REQUIRE(arr[PAGE_SIZE + 2] == i);
+        }
+
+        arr.set(PAGE_SIZE + 2, NIL_INDEX);
+        arr.reset();
+        REQUIRE(arr.allocatedPageCount() == 0);
+        REQUIRE(arr[PAGE_SIZE + 2] == NIL_INDEX);
+    }
+
+    SECTION("Reset and resize")
+    {
+        CPagedSparseArray arr;
+
+        arr.set(0, 0);
+        arr.set(PAGE_SIZE, 1);
+        arr.set(2 * PAGE_SIZE, 2);
+
+        arr.resize(PAGE_SIZE + 1);
+        REQUIRE(arr.size() == PAGE_SIZE + 1);
+        REQUIRE(arr.allocatedPageCount() == 2);
+        REQUIRE(arr[2 * PAGE_SIZE] == NIL_INDEX);
+
+        arr.reset();
+        REQUIRE(arr.size() == PAGE_SIZE + 1);
+        REQUIRE(arr.allocatedPageCount() == 0);
+        REQUIRE(arr[0] == NIL_INDEX);
+        REQUIRE(arr[PAGE_SIZE] == NIL_INDEX);
+    }
+
+    SECTION("Copy and move")
+    {
+        CPagedSparseArray arr;
+        arr.set(3, 3);
+        arr.set(PAGE_SIZE + 4, 4);
+
+        CPagedSparseArray copy = arr;
+        copy.set(3, 5);
+        REQUIRE(arr[3] == 3);
+        REQUIRE(copy[3] == 5);
+        REQUIRE(copy[PAGE_SIZE + 4] == 4);
+
+        CPagedSparseArray moved = std::move(copy);
+        REQUIRE(moved[3] == 5);
+        REQUIRE(moved[PAGE_SIZE + 4] == 4);
+        REQUIRE(moved.allocatedPageCount() == 2);
+    }
+}
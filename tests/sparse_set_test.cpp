@@ -50,9 +50,17 @@ TEST_CASE("Sparse set test")
         REQUIRE(testSet.sparse()[3] == 2);
 
         REQUIRE(testSet.dense().size() == 3);
-        REQUIRE(testSet.dense()[0].e == 1);
-        REQUIRE(testSet.dense()[1].e == 2);
-        REQUIRE(testSet.dense()[2].e == 3);
+        REQUIRE(testSet.dense()[0] == 1);
+        REQUIRE(testSet.dense()[1] == 2);
+        REQUIRE(testSet.dense()[2] == 3);
+
+        REQUIRE(testSet.denseIndices().size() == 3);
+        REQUIRE(testSet.denseIndices()[0] == 0);
+        REQUIRE(testSet.denseIndices()[1] == 1);
+        REQUIRE(testSet.denseIndices()[2] == 3);
+
+        REQUIRE(testSet.data() == testSet.dense().data());
+        REQUIRE(testSet.indices() == testSet.denseIndices().data());
     }
 
     SECTION("Lookup")
@@ -100,8 +108,53 @@ TEST_CASE("Sparse set test")
         REQUIRE(testSet.sparse()[3] == 1);
 
         REQUIRE(testSet.dense().size() == 2);
-        REQUIRE(testSet.dense()[0].e == 0);
-        REQUIRE(testSet.dense()[1].e == 3);
+        REQUIRE(testSet.dense()[0] == 0);
+        REQUIRE(testSet.dense()[1] == 3);
+
+        REQUIRE(testSet.denseIndices().size() == 2);
+        REQUIRE(testSet.denseIndices()[0] == 0);
+        REQUIRE(testSet.denseIndices()[1] == 3);
+    }
+
+
+
+    SECTION("Erasure of many elements")
+    {
+        for(unsigned int i = 0; i < 10; i++)
+        {
+            testSet.insert(i, (int)i);
+        }
+
+        // few elements, swap-removed
+        const CSparseSet<int>::index_type few[] { 2 };
+        testSet.eraseMany(few, 1);
+        // d: 0 1 9 3 4 5 6 7 8
+
+        REQUIRE(testSet.size() == 9);
+        REQUIRE(testSet.dense()[2] == 9);
+
+        // many elements, some not in the set, compacted in order
+        const CSparseSet<int>::index_type many[] { 1, 2, 4, 8, 20 };
+        testSet.eraseMany(many, 5);
+        // d: 0 9 3 5 6 7
+
+        REQUIRE(testSet.size() == 6);
+        REQUIRE_FALSE(testSet.contains(1));
+        REQUIRE_FALSE(testSet.contains(4));
+        REQUIRE_FALSE(testSet.contains(8));
+        REQUIRE(testSet.dense() == std::vector<int>{ 0, 9, 3, 5, 6, 7 });
+        REQUIRE(testSet.denseIndices() == std::vector<CSparseSet<int>::index_type>{ 0, 9, 3, 5, 6, 7 });
+        for(int i : testSet.dense())
+        {
+            REQUIRE(testSet.at(i) == i);
+        }
+
+        // all remaining elements
+        const CSparseSet<int>::index_type all[] { 0, 3, 5, 6, 7, 9 };
+        testSet.eraseMany(all, 6);
+
+        REQUIRE(testSet.empty());
+        REQUIRE(testSet.sparse()[9] == CSparseSet<int>::NIL_INDEX);
     }
 
 
@@ -124,5 +177,66 @@ TEST_CASE("Sparse set test")
         REQUIRE(testSet.sparse()[3] == CSparseSet<int>::NIL_INDEX);
 
         REQUIRE(testSet.dense().size() == 0);
+        REQUIRE(testSet.denseIndices().size() == 0);
+    }
+
+
+
+    SECTION("Tag types")
+    {
+        struct Tag {};
+        CSparseSet<Tag> tagSet;
+
+        for(unsigned int i = 0; i < 10; i++)
+        {
+            tagSet.insert(i, Tag{});
+        }
+        tagSet.insert(3, Tag{});
+
+        REQUIRE(tagSet.size() == 10);
+        REQUIRE(&tagSet.at(0) == &tagSet.at(9));
+        REQUIRE(&tagSet.at(0) == tagSet.data());
+
+        tagSet.erase(2);
+        // i: 0 1 9 3 4 5 6 7 8
+        REQUIRE_FALSE(tagSet.contains(2));
+        REQUIRE(tagSet.sparse()[9] == 2);
+        REQUIRE_THROWS(tagSet.at(2));
+
+        const CSparseSet<Tag>::index_type many[] { 0, 1, 4, 5, 20 };
+        tagSet.eraseMany(many, 5);
+
+        REQUIRE(tagSet.denseIndices() == std::vector<CSparseSet<Tag>::index_type>{ 9, 3, 6, 7, 8 });
+        REQUIRE(tagSet.sparse()[8] == 4);
+
+        tagSet.clear();
+        REQUIRE(tagSet.empty());
+        REQUIRE_FALSE(tagSet.contains(9));
+    }
+
+
+
+    SECTION("High indices")
+    {
+        CSparseSet<int> set;
+
+        set.insert(4000000, 1);
+
+        REQUIRE(set.contains(4000000));
+        REQUIRE_FALSE(set.contains(0));
+        REQUIRE_FALSE(set.contains(3999999));
+        REQUIRE_FALSE(set.contains(5000000));
+        REQUIRE(set.at(4000000) == 1);
+
+        REQUIRE(set.sparse().size() == 4000001);
+        REQUIRE(set.sparse().allocatedPageCount() == 1);
+
+        // page is kept for the next insertion
+        set.erase(4000000);
+        REQUIRE_FALSE(set.contains(4000000));
+        REQUIRE(set.sparse().allocatedPageCount() == 1);
+
+        set.clear();
+        REQUIRE(set.sparse().allocatedPageCount() == 0);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch.hpp>
+
+#include "../include/chestnut/ecs/thread_pool.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace chestnut::ecs;
+
+
+TEST_CASE( "Thread pool test" )
+{
+    CThreadPool pool(GENERATE(0u, 1u, 4u));
+
+    SECTION("Every task runs exactly once")
+    {
+        std::vector<std::atomic<int>> counters(10000);
+
+        pool.parallelFor((unsigned int)counters.size(), [&counters](unsigned int taskIdx) {
+            counters[taskIdx]++;
+        });
+
+        bool allOnce = true;
+        for(const auto& counter : counters)
+        {
+            allOnce = allOnce && counter.load() == 1;
+        }
+        REQUIRE(allOnce);
+    }
+
+    SECTION("Pool can be reused")
+    {
+        std::atomic<int> sum = 0;
+
+        for(int frame = 0; frame < 100; frame++)
+        {
+            pool.parallelFor(64, [&sum](unsigned int taskIdx) {
+                sum += (int)taskIdx;
+            });
+        }
+
+        // 100 * sum of 0..63
+        REQUIRE(sum == 201600);
+    }
+
+    SECTION("No tasks")
+    {
+        bool called = false;
+        pool.parallelFor(0, [&called](unsigned int taskIdx) {
+            called = true;
+        });
+
+        REQUIRE_FALSE(called);
+    }
+
+    SECTION("Nested parallelFor")
+    {
+        std::atomic<int> count = 0;
+
+        pool.parallelFor(8, [&](unsigned int outerIdx) {
+            pool.parallelFor(8, [&](unsigned int innerIdx) {
+                count++;
+            });
+        });
+
+        REQUIRE(count == 64);
+    }
+
+    SECTION("Exception is rethrown on the calling thread")
+    {
+        REQUIRE_THROWS_AS(pool.parallelFor(100, [](unsigned int taskIdx) {
+            if(taskIdx == 50)
+            {
+                throw std::runtime_error("task failed");
+            }
+        }), std::runtime_error);
+
+        // pool still works afterwards
+        std::atomic<int> count = 0;
+        pool.parallelFor(10, [&count](unsigned int taskIdx) {
+            count++;
+        });
+        REQUIRE(count == 10);
+    }
+
+    SECTION("Thread slots")
+    {
+        REQUIRE(pool.getThreadSlotCount() == pool.getWorkerCount() + 1);
+        REQUIRE(pool.currentThreadSlot() == 0);
+
+        std::atomic<bool> slotsInRange = true;
+        pool.parallelFor(1000, [&](unsigned int taskIdx) {
+            if(pool.currentThreadSlot() >= pool.getThreadSlotCount())
+            {
+                slotsInRange = false;
+            }
+        });
+        REQUIRE(slotsInRange);
+    }
+}